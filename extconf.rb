@@ -23,6 +23,12 @@ printf("  \$CFLAGS = %s\n", $CFLAGS)
 printf("  \$LDFLAGS = %s\n", $LDFLAGS)
 printf("  \$libs = %s\n", $libs)
 
+have_func('rb_objc_define_method')
+have_func('rb_str_modify_expand')
+if have_header('ruby/thread.h')
+  have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+end
+
 if have_header('tcutil.h')
   create_makefile('tokyocabinet')
 end
@@ -475,6 +475,66 @@ def procmisc(name, rnum)
       end
     end
   end
+  printf("checking multiple retrieval:\n")
+  mkeys = [rnum + 1, rnum + 2, rnum + 3].map { |id| sprintf("%08d", id) }
+  if !adb.put(mkeys[0], "one") || !adb.put(mkeys[1], "two") ||
+      adb.mget(mkeys) != { mkeys[0] => "one", mkeys[1] => "two" }
+    eprint(adb, "mget")
+    err = true
+  end
+  printf("checking buffered retrieval:\n")
+  tbuf = ""
+  tkey = sprintf("%08d", rnum + 8)
+  if !adb.put(tkey, "x" * 8) || !adb.get_into(tkey, tbuf).equal?(tbuf) || tbuf != "x" * 8 ||
+      adb.get_into(mkeys[1], tbuf) != "two" || adb.get_into(sprintf("%08d", rnum + 9), tbuf) || tbuf != "two"
+    eprint(adb, "get_into")
+    err = true
+  end
+  begin
+    adb.get_into(tkey, tkey)
+    eprint(adb, "get_into")
+    err = true
+  rescue ArgumentError
+  end
+  printf("checking bulk storing:\n")
+  bkeys = [rnum + 4, rnum + 5, rnum + 6].map { |id| sprintf("%08d", id) }
+  res = adb.put_all({ bkeys[0] => "one", bkeys[1] => "two" })
+  if res != [2, []] || adb.get(bkeys[1]) != "two"
+    eprint(adb, "put_all")
+    err = true
+  end
+  res = adb.put_all([[bkeys[0], "uno"], [bkeys[2], "three"]], :mode => :keep, :transactional => false)
+  if res != [1, [bkeys[0]]] || adb.get(bkeys[0]) != "one" || adb.get(bkeys[2]) != "three"
+    eprint(adb, "put_all")
+    err = true
+  end
+  printf("checking bulk removal:\n")
+  res = adb.mout([bkeys[0], bkeys[1], sprintf("%08d", rnum + 7)])
+  if res != [2, [sprintf("%08d", rnum + 7)]] || adb.get(bkeys[0]) || !adb.get(bkeys[2])
+    eprint(adb, "mout")
+    err = true
+  end
+  printf("checking batch iterator:\n")
+  brecs = []
+  adb.each_batch(7) do |recs|
+    if recs.size < 1 || recs.size > 7
+      eprint(adb, "each_batch")
+      err = true
+      break
+    end
+    brecs.concat(recs)
+  end
+  if brecs.size != adb.rnum || brecs != adb.each.to_a
+    eprint(adb, "each_batch")
+    err = true
+  end
+  printf("checking parallel iterator:\n")
+  precs = {}
+  adb.parallel_each(:threads => 4) { |tkey, tvalue| precs[tkey] = tvalue }
+  if precs.size != adb.rnum || precs.first(10).any? { |tkey, tvalue| adb.get(tkey) != tvalue }
+    eprint(adb, "parallel_each")
+    err = true
+  end
   printf("checking hash-like iterator:\n")
   inum = 0
   adb.each do |tkey, tvalue|
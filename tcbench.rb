@@ -0,0 +1,315 @@
+#! /usr/local/bin/macruby -w
+
+#-------------------------------------------------------------------------------------------------
+# The micro benchmarks of the database API
+#                                                       Copyright (C) 2006-2009 Mikio Hirabayashi
+# This file is part of Tokyo Cabinet.
+# Tokyo Cabinet is free software; you can redistribute it and/or modify it under the terms of
+# the GNU Lesser General Public License as published by the Free Software Foundation; either
+# version 2.1 of the License or any later version.  Tokyo Cabinet is distributed in the hope
+# that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+# License for more details.
+# You should have received a copy of the GNU Lesser General Public License along with Tokyo
+# Cabinet; if not, write to the Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+# Boston, MA 02111-1307 USA.
+#-------------------------------------------------------------------------------------------------
+
+
+require 'tokyocabinet'
+include TokyoCabinet
+
+
+# main routine
+def main
+  ARGV.length >= 1 || usage
+  if ARGV[0] == "call"
+    rv = runcall
+  elsif ARGV[0] == "mutex"
+    rv = runmutex
+  elsif ARGV[0] == "table"
+    rv = runtable
+  else
+    usage
+  end
+  GC.start
+  return rv
+end
+
+
+# print the usage and exit
+def usage
+  STDERR.printf("%s: micro benchmarks of the database API\n", $progname)
+  STDERR.printf("\n")
+  STDERR.printf("usage:\n")
+  STDERR.printf("  %s call path rnum\n", $progname)
+  STDERR.printf("  %s mutex path rnum\n", $progname)
+  STDERR.printf("  %s table path rnum\n", $progname)
+  STDERR.printf("\n")
+  exit(1)
+end
+
+
+# print error message of hash database
+def eprint(hdb, func)
+  path = hdb.path
+  STDERR.printf("%s: %s: %s: %s\n", $progname, path ? path : "-", func, hdb.errmsg)
+end
+
+
+# measure a block and print the cost per call
+def measure(label, rnum)
+  GC.start
+  stime = Time.now
+  yield
+  etime = Time.now
+  printf("%-20s %10d calls %9.3f sec. %9.1f ns/call\n",
+         label, rnum, etime - stime, (etime - stime) * 1000000000.0 / rnum)
+end
+
+
+# parse arguments of call command
+def runcall
+  path = nil
+  rnum = nil
+  i = 1
+  while i < ARGV.length
+    if !path
+      path = ARGV[i]
+    elsif !rnum
+      rnum = ARGV[i].to_i
+    else
+      usage
+    end
+    i += 1
+  end
+  usage if !path || !rnum || rnum < 1
+  rv = proccall(path, rnum)
+  return rv
+end
+
+
+# perform call command
+def proccall(path, rnum)
+  printf("<Per-call Overhead Benchmark>\n  path=%s  rnum=%d\n\n", path, rnum)
+  err = false
+  hdb = HDB::new
+  if !hdb.setcache(1024)
+    eprint(hdb, "setcache")
+    err = true
+  end
+  if !hdb.open(path, HDB::OWRITER | HDB::OCREAT | HDB::OTRUNC)
+    eprint(hdb, "open")
+    err = true
+  end
+  keys = []
+  (1..1024).each do |i|
+    key = sprintf("%08d", i)
+    if !hdb.put(key, key)
+      eprint(hdb, "put")
+      err = true
+      break
+    end
+    keys.push(key)
+  end
+  measure("ecode", rnum) do
+    rnum.times do
+      hdb.ecode
+    end
+  end
+  measure("rnum", rnum) do
+    rnum.times do
+      hdb.rnum
+    end
+  end
+  measure("get(cached)", rnum) do
+    rnum.times do |i|
+      hdb.get(keys[i & 1023])
+    end
+  end
+  measure("put", rnum) do
+    rnum.times do |i|
+      hdb.put(keys[i & 1023], keys[i & 1023])
+    end
+  end
+  if !hdb.close
+    eprint(hdb, "close")
+    err = true
+  end
+  printf("%s\n\n", err ? "error" : "ok")
+  return err ? 1 : 0
+end
+
+
+# parse arguments of mutex command
+def runmutex
+  path = nil
+  rnum = nil
+  i = 1
+  while i < ARGV.length
+    if !path
+      path = ARGV[i]
+    elsif !rnum
+      rnum = ARGV[i].to_i
+    else
+      usage
+    end
+    i += 1
+  end
+  usage if !path || !rnum || rnum < 1
+  rv = procmutex(path, rnum)
+  return rv
+end
+
+
+# perform mutex command
+def procmutex(path, rnum)
+  printf("<Mutex Overhead Benchmark>\n  path=%s  rnum=%d\n\n", path, rnum)
+  err = false
+  keys = []
+  rnum.times do |i|
+    keys.push(sprintf("%08d", i + 1))
+  end
+  [["threadsafe", {}], ["single-owner", { :threadsafe => false }]].each do |label, opts|
+    hdb = HDB::new(opts)
+    if !hdb.open(path, HDB::OWRITER | HDB::OCREAT | HDB::OTRUNC)
+      eprint(hdb, "open")
+      err = true
+      next
+    end
+    measure(label + " put", rnum) do
+      keys.each do |key|
+        if !hdb.put(key, key)
+          eprint(hdb, "put")
+          err = true
+          break
+        end
+      end
+    end
+    measure(label + " get", rnum) do
+      keys.each do |key|
+        if !hdb.get(key)
+          eprint(hdb, "get")
+          err = true
+          break
+        end
+      end
+    end
+    if !hdb.close
+      eprint(hdb, "close")
+      err = true
+    end
+  end
+  printf("%s\n\n", err ? "error" : "ok")
+  return err ? 1 : 0
+end
+
+
+# parse arguments of table command
+def runtable
+  path = nil
+  rnum = nil
+  i = 1
+  while i < ARGV.length
+    if !path
+      path = ARGV[i]
+    elsif !rnum
+      rnum = ARGV[i].to_i
+    else
+      usage
+    end
+    i += 1
+  end
+  usage if !path || !rnum || rnum < 1
+  rv = proctable(path, rnum)
+  return rv
+end
+
+
+# perform table command
+def proctable(path, rnum)
+  printf("<Table Iteration Benchmark>\n  path=%s  rnum=%d\n\n", path, rnum)
+  err = false
+  tdb = TDB::new
+  if !tdb.open(path, TDB::OWRITER | TDB::OCREAT | TDB::OTRUNC)
+    eprint(tdb, "open")
+    err = true
+  end
+  measure("put", rnum) do
+    rnum.times do |i|
+      buf = sprintf("%08d", i + 1)
+      if !tdb.put(buf, { "name" => buf, "age" => (i % 100).to_s, "lang" => "ja,en" })
+        eprint(tdb, "put")
+        err = true
+        break
+      end
+    end
+  end
+  if !tdb.close || !tdb.open(path, TDB::OREADER)
+    eprint(tdb, "open")
+    err = true
+  end
+  inum = 0
+  measure("iternext+get", rnum) do
+    tdb.iterinit
+    while pkey = tdb.iternext
+      inum += 1 if tdb.get(pkey)
+    end
+  end
+  if inum != rnum
+    eprint(tdb, "iternext")
+    err = true
+  end
+  inum = 0
+  measure("each", rnum) do
+    tdb.each do |pkey, cols|
+      inum += 1
+    end
+  end
+  if inum != rnum
+    eprint(tdb, "each")
+    err = true
+  end
+  if !tdb.close || !tdb.open(path, TDB::OWRITER) || !tdb.setindex("age", TDB::ITDECIMAL) ||
+      !tdb.close || !tdb.open(path, TDB::OREADER)
+    eprint(tdb, "setindex")
+    err = true
+  end
+  qry = TDBQRY::new(tdb)
+  qry.addcond("age", TDBQRY::QCNUMLT, "50")
+  qnum = 10
+  snum = 0
+  measure("search.size", qnum) do
+    qnum.times do
+      snum = qry.search.size
+    end
+  end
+  cnum = 0
+  measure("count", qnum) do
+    qnum.times do
+      cnum = qry.count
+    end
+  end
+  if snum != cnum || cnum != (rnum / 100) * 50 + [rnum % 100, 50].min
+    eprint(tdb, "count")
+    err = true
+  end
+  if !tdb.close
+    eprint(tdb, "close")
+    err = true
+  end
+  printf("%s\n\n", err ? "error" : "ok")
+  return err ? 1 : 0
+end
+
+
+# execute main
+STDOUT.sync = true
+$progname = $0.dup
+$progname.gsub!(/.*\//, "")
+srand
+exit(main)
+
+
+
+# END OF FILE
@@ -574,6 +574,59 @@ def procmisc(path, rnum, opts, omode)
       end
     end
   end
+  printf("checking multiple retrieval:\n")
+  if !bdb.put("mget:1", "one") || !bdb.putdup("mget:1", "uno") || !bdb.put("mget:2", "two") ||
+      bdb.mget(["mget:1", "mget:2", "mget:3"]) != { "mget:1" => "one", "mget:2" => "two" }
+    eprint(bdb, "mget")
+    err = true
+  end
+  printf("checking buffered retrieval:\n")
+  tbuf = ""
+  if !bdb.put("into:1", "x" * 100) || !bdb.get_into("into:1", tbuf).equal?(tbuf) || tbuf != "x" * 100 ||
+      bdb.get_into("mget:2", tbuf) != "two" || bdb.get_into("into:2", tbuf) || tbuf != "two"
+    eprint(bdb, "get_into")
+    err = true
+  end
+  begin
+    tkey = "into:1"
+    bdb.get_into(tkey, tkey)
+    eprint(bdb, "get_into")
+    err = true
+  rescue ArgumentError
+  end
+  printf("checking bulk storing:\n")
+  res = bdb.put_all({ "bulk:1" => "one", "bulk:2" => "two" })
+  if res != [2, []] || bdb.get("bulk:2") != "two"
+    eprint(bdb, "put_all")
+    err = true
+  end
+  res = bdb.put_all([["bulk:1", "uno"], ["bulk:2", "+"]], :mode => :keep, :transactional => false)
+  if res != [0, ["bulk:1", "bulk:2"]] || bdb.get("bulk:1") != "one" ||
+      bdb.put_all([["bulk:2", "+"]], :mode => :cat) != [1, []] || bdb.get("bulk:2") != "two+"
+    eprint(bdb, "put_all")
+    err = true
+  end
+  printf("checking bulk removal:\n")
+  if !bdb.putdup("mout:1", "a") || !bdb.putdup("mout:1", "b") || !bdb.put("mout:2", "c") ||
+      bdb.mout(["mout:1", "mout:none"]) != [1, ["mout:none"]] || bdb.get("mout:1") != "b" ||
+      bdb.mout(["mout:1", "mout:2"], :dup => true) != [2, []] || bdb.get("mout:1") || bdb.get("mout:2")
+    eprint(bdb, "mout")
+    err = true
+  end
+  printf("checking batch iterator:\n")
+  brecs = []
+  bdb.each_batch(7) do |recs|
+    if recs.size < 1 || recs.size > 7
+      eprint(bdb, "each_batch")
+      err = true
+      break
+    end
+    brecs.concat(recs)
+  end
+  if brecs.size != bdb.rnum || brecs != bdb.each.to_a
+    eprint(bdb, "each_batch")
+    err = true
+  end
   printf("checking hash-like iterator:\n")
   inum = 0
   bdb.each do |tkey, tvalue|
@@ -586,6 +639,15 @@ def procmisc(path, rnum, opts, omode)
     inum += 1
   end
   printf(" (%08d)\n", inum) if rnum > 250
+  if bdb.keys.zip(bdb.values) != bdb.each.to_a
+    eprint(bdb, "keys")
+    err = true
+  end
+  bdb.keys.each { |tkey| bdb.out(tkey) }
+  if bdb.rnum != 0
+    eprint(bdb, "out")
+    err = true
+  end
   bdb.clear
   printf("record number: %d\n", bdb.rnum)
   printf("size: %d\n", bdb.fsiz)
@@ -593,6 +655,138 @@ def procmisc(path, rnum, opts, omode)
     eprint(bdb, "close")
     err = true
   end
+  printf("checking integer key codec:\n")
+  npath = path + "-int"
+  ibdb = BDB::new
+  ibdb.key_codec = :int64
+  if !ibdb.setcmpfunc(BDB::CMPINT64)
+    eprint(ibdb, "setcmpfunc")
+    err = true
+  end
+  if !ibdb.open(npath, BDB::OWRITER | BDB::OCREAT | BDB::OTRUNC | omode)
+    eprint(ibdb, "open")
+    err = true
+  end
+  for i in 1..rnum
+    if !ibdb.put(rnum - i * 2, i)
+      eprint(ibdb, "put")
+      err = true
+      break
+    end
+  end
+  keys = ibdb.keys.to_a
+  if ibdb.key_codec != :int64 || keys.size != rnum || keys.first != -rnum ||
+      keys != keys.sort || ibdb.get(rnum - 2) != "1"
+    eprint(ibdb, "(validation)")
+    err = true
+  end
+  if ibdb.range(-10, true, 10, false) != keys.select { |k| k >= -10 && k < 10 }
+    eprint(ibdb, "range")
+    err = true
+  end
+  recs = []
+  ibdb.each_range(-10, true, 10, false) { |tkey, tvalue| recs.push([tkey, tvalue]) }
+  if recs != keys.select { |k| k >= -10 && k < 10 }.map { |k| [k, ibdb.get(k)] } ||
+      ibdb.each_range(-10, false, nil, false, :limit => 3).map { |pair| pair[0] } !=
+      keys.select { |k| k > -10 }.first(3)
+    eprint(ibdb, "each_range")
+    err = true
+  end
+  begin
+    ibdb.each_range(-10, true, 10, false, :limit => "x") { |tkey, tvalue| }
+    eprint(ibdb, "each_range")
+    err = true
+  rescue TypeError
+  end
+  if ibdb.each_reverse(:limit => 3).map { |pair| pair[0] } != keys.last(3).reverse ||
+      ibdb.range(-10, true, 10, false, 2, :reverse => true) != keys.select { |k| k >= -10 && k < 10 }.last(2).reverse
+    eprint(ibdb, "each_reverse")
+    err = true
+  end
+  cur = BDBCUR::new(ibdb)
+  if !cur.jump(-rnum) || cur.key != -rnum
+    eprint(ibdb, "cur::jump")
+    err = true
+  end
+  if !cur.first || cur.next_n(2).map { |pair| pair[0] } != keys.first(2) ||
+      cur.next_n(2).map { |pair| pair[0] } != keys[2, 2] || cur.key != keys[4] ||
+      !cur.last || cur.prev_n(3).map { |pair| pair[0] } != keys.last(3).reverse
+    eprint(ibdb, "cur::next_n")
+    err = true
+  end
+  printf("checking bulk loading:\n")
+  bpath = path + "-bulk"
+  bbdb = BDB::new
+  bbdb.key_codec = :int64
+  if !bbdb.setcmpfunc(BDB::CMPINT64)
+    eprint(bbdb, "setcmpfunc")
+    err = true
+  end
+  if !bbdb.open(bpath, BDB::OWRITER | BDB::OCREAT | BDB::OTRUNC | omode)
+    eprint(bbdb, "open")
+    err = true
+  end
+  if bbdb.bulk_load(ibdb) != [rnum, 0] || bbdb.keys.to_a != keys ||
+      bbdb.bulk_load([[rnum * 2, "a"], [0, "b"]]) != [2, 1] || bbdb.get(0) != "b"
+    eprint(bbdb, "bulk_load")
+    err = true
+  end
+  if bbdb.bulk_load([[rnum * 4 + 1, "x"], [rnum * 4 + 1, "y"]], :dup => true) != [2, 0] ||
+      bbdb.getlist(rnum * 4 + 1) != ["x", "y"]
+    eprint(bbdb, "bulk_load")
+    err = true
+  end
+  begin
+    bbdb.bulk_load([[rnum * 4 + 3, "x"], [rnum * 4 + 5]])
+    eprint(bbdb, "bulk_load")
+    err = true
+  rescue ArgumentError
+    if bbdb.get(rnum * 4 + 3)
+      eprint(bbdb, "bulk_load")
+      err = true
+    end
+  end
+  if !bbdb.close
+    eprint(bbdb, "close")
+    err = true
+  end
+  File::unlink(bpath)
+  if !ibdb.close
+    eprint(ibdb, "close")
+    err = true
+  end
+  File::unlink(npath)
+  printf("checking custom comparison:\n")
+  cpath = path + "-cmp"
+  cbdb = BDB::new
+  if !cbdb.setcmpfunc(Proc.new { |a, b| b <=> a })
+    eprint(cbdb, "setcmpfunc")
+    err = true
+  end
+  if !cbdb.open(cpath, BDB::OWRITER | BDB::OCREAT | BDB::OTRUNC | omode)
+    eprint(cbdb, "open")
+    err = true
+  end
+  ckeys = []
+  for i in 1..100
+    ckeys.push(sprintf("%08d", i))
+    if !cbdb.put(ckeys.last, i)
+      eprint(cbdb, "put")
+      err = true
+      break
+    end
+  end
+  ckeys.reverse!
+  if cbdb.range("00000080", true, "00000020", false) != ckeys.select { |k| k <= "00000080" && k > "00000020" } ||
+      cbdb.range(nil, false, nil, false, 3) != ckeys.first(3)
+    eprint(cbdb, "range")
+    err = true
+  end
+  if !cbdb.close
+    eprint(cbdb, "close")
+    err = true
+  end
+  File::unlink(cpath)
   printf("time: %.3f\n", Time.now - stime)
   printf("%s\n\n", err ? "error" : "ok")
   return err ? 1 : 0
@@ -515,6 +515,72 @@ def procmisc(path, rnum, omode)
       end
     end
   end
+  printf("checking multiple retrieval:\n")
+  mkeys = [rnum + 1, rnum + 2, rnum + 3].map { |id| id.to_s }
+  if !fdb.put(mkeys[0], "one") || !fdb.put(mkeys[1], "two") ||
+      fdb.mget(mkeys) != { mkeys[0] => "one", mkeys[1] => "two" }
+    eprint(fdb, "mget")
+    err = true
+  end
+  printf("checking buffered retrieval:\n")
+  tbuf = ""
+  tkey = (rnum + 8).to_s
+  if !fdb.put(tkey, "x" * 8) || !fdb.get_into(tkey, tbuf).equal?(tbuf) || tbuf != "x" * 8 ||
+      fdb.get_into(mkeys[1], tbuf) != "two" || fdb.get_into((rnum + 9).to_s, tbuf) || tbuf != "two"
+    eprint(fdb, "get_into")
+    err = true
+  end
+  begin
+    fdb.get_into(tkey, tkey)
+    eprint(fdb, "get_into")
+    err = true
+  rescue ArgumentError
+  end
+  printf("checking bulk storing:\n")
+  bkeys = [rnum + 4, rnum + 5, rnum + 6].map { |id| id.to_s }
+  res = fdb.put_all({ bkeys[0] => "one", bkeys[1] => "two" })
+  if res != [2, []] || fdb.get(bkeys[1]) != "two"
+    eprint(fdb, "put_all")
+    err = true
+  end
+  res = fdb.put_all([[bkeys[0], "uno"], [bkeys[2], "three"]], :mode => :keep, :transactional => false)
+  if res != [1, [bkeys[0]]] || fdb.get(bkeys[0]) != "one" || fdb.get(bkeys[2]) != "three"
+    eprint(fdb, "put_all")
+    err = true
+  end
+  printf("checking bulk removal:\n")
+  res = fdb.mout([bkeys[0], bkeys[1], (rnum + 7).to_s])
+  if res != [2, [(rnum + 7).to_s]] || fdb.get(bkeys[0]) || !fdb.get(bkeys[2])
+    eprint(fdb, "mout")
+    err = true
+  end
+  printf("checking batch iterator:\n")
+  brecs = []
+  fdb.each_batch(7) do |recs|
+    if recs.size < 1 || recs.size > 7
+      eprint(fdb, "each_batch")
+      err = true
+      break
+    end
+    brecs.concat(recs)
+  end
+  if brecs.size != fdb.rnum || brecs != fdb.each.to_a
+    eprint(fdb, "each_batch")
+    err = true
+  end
+  printf("checking integer identifiers:\n")
+  ids = fdb.range_ids
+  if ids.size != fdb.rnum || fdb.keys.to_a != ids.map { |id| id.to_s } ||
+      (ids.size > 0 && fdb.get_id(ids.first) != fdb.get(ids.first.to_s))
+    eprint(fdb, "range_ids")
+    err = true
+  end
+  recs = []
+  fdb.each_id_range(ids[1], ids[-2]) { |id, tvalue| recs.push(id) if tvalue == fdb.get_id(id) }
+  if ids.size > 2 && recs != ids[1..-2]
+    eprint(fdb, "each_id_range")
+    err = true
+  end
   printf("checking hash-like iterator:\n")
   inum = 0
   fdb.each do |tkey, tvalue|
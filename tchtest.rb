@@ -562,6 +562,113 @@ def procmisc(path, rnum, opts, omode)
       end
     end
   end
+  printf("checking scalar keys:\n")
+  [[12345, "12345"], [-7, "-7"], [1 << 40, "1099511627776"], [1 << 62, "4611686018427387904"],
+   [true, "true"], [false, "false"], [nil, "nil"]].each do |key, str|
+    if !hdb.put(key, key) || hdb.get(str) != str || hdb[key] != str
+      eprint(hdb, "put")
+      err = true
+      break
+    end
+  end
+  printf("checking multiple retrieval:\n")
+  if !hdb.put("mget:1", "one") || !hdb.put("mget:2", "two") ||
+      hdb.mget(["mget:1", "mget:2", "mget:3"]) != { "mget:1" => "one", "mget:2" => "two" }
+    eprint(hdb, "mget")
+    err = true
+  end
+  printf("checking buffered retrieval:\n")
+  tbuf = ""
+  if !hdb.put("into:1", "x" * 100) || !hdb.get_into("into:1", tbuf).equal?(tbuf) || tbuf != "x" * 100 ||
+      hdb.get_into("mget:2", tbuf) != "two" || hdb.get_into("into:2", tbuf) || tbuf != "two"
+    eprint(hdb, "get_into")
+    err = true
+  end
+  begin
+    tkey = "into:1"
+    hdb.get_into(tkey, tkey)
+    eprint(hdb, "get_into")
+    err = true
+  rescue ArgumentError
+  end
+  printf("checking bulk storing:\n")
+  res = hdb.put_all({ "bulk:1" => "one", "bulk:2" => "two" })
+  if res != [2, []] || hdb.get("bulk:2") != "two"
+    eprint(hdb, "put_all")
+    err = true
+  end
+  res = hdb.put_all([["bulk:1", "uno"], ["bulk:3", "three"]], :mode => :keep, :transactional => false)
+  if res != [1, ["bulk:1"]] || hdb.get("bulk:1") != "one" || hdb.get("bulk:3") != "three"
+    eprint(hdb, "put_all")
+    err = true
+  end
+  printf("checking bulk removal:\n")
+  res = hdb.mout(["bulk:1", "bulk:2", "bulk:none"])
+  if res != [2, ["bulk:none"]] || hdb.get("bulk:1") || !hdb.get("bulk:3")
+    eprint(hdb, "mout")
+    err = true
+  end
+  printf("checking batch iterator:\n")
+  bnum = 0
+  hdb.each_batch(7) do |recs|
+    if recs.size < 1 || recs.size > 7 || recs.any? { |pair| hdb.get(pair[0]) != pair[1] }
+      eprint(hdb, "each_batch")
+      err = true
+      break
+    end
+    bnum += recs.size
+  end
+  if bnum != hdb.rnum
+    eprint(hdb, "each_batch")
+    err = true
+  end
+  printf("checking position tokens:\n")
+  srecs = {}
+  page, token = hdb.scan(nil, 7)
+  while page
+    page.each { |tkey, tvalue| srecs[tkey] = tvalue }
+    break if !token
+    page, token = hdb.scan(token, 7)
+  end
+  hdb.iterinit
+  ikeys = [hdb.iternext]
+  hdb.scan(nil, 3)
+  ikeys.push(hdb.iternext)
+  if !page || srecs.size != hdb.rnum || srecs.first(10).any? { |tkey, tvalue| hdb.get(tkey) != tvalue } ||
+      ikeys != hdb.keys.first(2)
+    eprint(hdb, "scan")
+    err = true
+  end
+  printf("checking parallel iterator:\n")
+  precs = {}
+  hdb.parallel_each(:threads => 4) { |tkey, tvalue| precs[tkey] = tvalue }
+  if precs.size != hdb.rnum || precs.first(10).any? { |tkey, tvalue| hdb.get(tkey) != tvalue }
+    eprint(hdb, "parallel_each")
+    err = true
+  end
+  printf("checking enumerators:\n")
+  if hdb.keys.size != hdb.rnum || hdb.keys.lazy.select { |tkey| hdb.get(tkey) }.first(3).size != 3 ||
+      hdb.each.first(2).any? { |pair| hdb.get(pair[0]) != pair[1] } || hdb.each_value.first != hdb.values.first
+    eprint(hdb, "keys")
+    err = true
+  end
+  printf("checking value views:\n")
+  vnum = 0
+  tview = nil
+  hdb.each(:view => true) do |tkey, tvalue|
+    tview = tvalue
+    vnum += 1 if tview.frozen? && tview == hdb.get(tkey) && tview.to_s == hdb.get(tkey)
+  end
+  if vnum != hdb.rnum || (tview && tview.valid?)
+    eprint(hdb, "each")
+    err = true
+  end
+  begin
+    hdb.each(1) { |tkey, tvalue| }
+    eprint(hdb, "each")
+    err = true
+  rescue TypeError
+  end
   printf("checking hash-like iterator:\n")
   inum = 0
   hdb.each do |tkey, tvalue|
@@ -574,6 +681,11 @@ def procmisc(path, rnum, opts, omode)
     inum += 1
   end
   printf(" (%08d)\n", inum) if rnum > 250
+  hdb.keys.each { |tkey| hdb.out(tkey) }
+  if hdb.rnum != 0
+    eprint(hdb, "out")
+    err = true
+  end
   hdb.clear
   printf("record number: %d\n", hdb.rnum)
   printf("size: %d\n", hdb.fsiz)
@@ -581,6 +693,32 @@ def procmisc(path, rnum, opts, omode)
     eprint(hdb, "close")
     err = true
   end
+  printf("checking single-owner mode:\n")
+  hdb = HDB::new(:threadsafe => false)
+  if !hdb.open(path, HDB::OWRITER | HDB::OCREAT | HDB::OTRUNC)
+    eprint(hdb, "open")
+    err = true
+  end
+  if !hdb.put("owner", "main") || hdb.get("owner") != "main"
+    eprint(hdb, "put")
+    err = true
+  end
+  terr = Thread::new do
+    begin
+      hdb.get("owner")
+      false
+    rescue ThreadError
+      true
+    end
+  end.value
+  if !terr
+    eprint(hdb, "get")
+    err = true
+  end
+  if !hdb.close
+    eprint(hdb, "close")
+    err = true
+  end
   printf("time: %.3f\n", Time.now - stime)
   printf("%s\n\n", err ? "error" : "ok")
   return err ? 1 : 0
@@ -600,6 +600,58 @@ def procmisc(path, rnum, opts, omode)
     eprint(tdb, "qry::proc")
     err = true
   end
+  pnum = 0
+  prow = nil
+  begin
+    qry.proc do |pkey, cols|
+      prow = cols
+      pnum += 1 if cols.has_key?("icnt") && cols["icnt"] == cols.to_hash["icnt"]
+      raise "stop" if pnum >= 2
+      0
+    end
+  rescue RuntimeError
+    pnum += 10
+  end
+  if (irnum >= 2 && pnum != 12) || (prow && prow.valid?)
+    eprint(tdb, "qry::proc")
+    err = true
+  end
+  hnum = 0
+  qry.proc do |pkey, cols|
+    chash = cols.dup
+    hnum += 1 if chash.is_a?(Hash) && chash == cols.to_hash && cols.values == chash.values &&
+      cols.each { |name, value| } == cols && !cols.empty? &&
+      cols.select { |name, value| name == "icnt" } == { "icnt" => chash["icnt"] } &&
+      cols.reject { |name, value| name == "icnt" }.size == chash.size - 1 &&
+      cols.fetch("nothing", "none") == "none" && cols.fetch("icnt") == chash["icnt"]
+    TDBQRY::QPSTOP
+  end
+  if irnum > 0 && hnum != 1
+    eprint(tdb, "qry::proc")
+    err = true
+  end
+  rv = qry.proc do |pkey, cols|
+    cols.merge!("upd" => pkey)
+    TDBQRY::QPPUT
+  end
+  if !rv || ires.any? { |pkey| cols = tdb.get(pkey); !cols || cols["upd"] != pkey || !cols["icnt"] }
+    eprint(tdb, "qry::proc")
+    err = true
+  end
+  if !tdb.put("row:1", { "rt" => "1" }) || !tdb.put("row:2", { "rt" => "1" })
+    eprint(tdb, "put")
+    err = true
+  end
+  rqry = TDBQRY::new(tdb)
+  rqry.addcond("rt", TDBQRY::QCSTREQ, "1")
+  rv = rqry.proc do |pkey, cols|
+    cols["rt"] = "2" if pkey == "row:1"
+    TDBQRY::QPPUT | TDBQRY::QPOUT
+  end
+  if !rv || tdb.get("row:1") != { "rt" => "2" } || tdb.get("row:2") || !tdb.out("row:1")
+    eprint(tdb, "qry::proc")
+    err = true
+  end
   qry.addcond("icnt", TDBQRY::QCNUMGT, 0)
   mures = qry.metasearch([ qry, qry ], TDBQRY::MSUNION)
   if mures.length != irnum
@@ -650,6 +702,71 @@ def procmisc(path, rnum, opts, omode)
       break
     end
   end
+  rows = qry.search_rows(:columns => ["text"])
+  if rows.map { |pair| pair[0] } != qry.search ||
+      rows.any? { |pkey, cols| cols != { "text" => tdb.get(pkey)["text"] } } ||
+      (rows.size > 0 && tdb.get(rows[0][0], :columns => ["text", "nothing"]) != rows[0][1])
+    eprint(tdb, "qry::search_rows")
+    err = true
+  end
+  erows = []
+  qry.each { |pkey, cols| erows.push([pkey, cols]) }
+  bnum = 0
+  qry.each_batch(3) { |recs| bnum += recs.size }
+  inum = 0
+  qry.each { |pkey, cols| break if (inum += 1) >= 2 }
+  qnum = 0
+  qry.each { |pkey, cols| qnum += 1 if tdb.get(pkey) == cols && tdb.put(pkey, cols) }
+  if erows.map { |pair| pair[0] } != rows.map { |pair| pair[0] } || bnum != rows.size ||
+      (rows.size > 0 && erows[0][1] != tdb.get(erows[0][0])) || inum != [rows.size, 2].min ||
+      qnum != rows.size
+    eprint(tdb, "qry::each")
+    err = true
+  end
+  qry.setlimit(1, 1)
+  lnum = qry.count
+  qry.setlimit(100, 1)
+  if qry.count != rows.size || qry.search != rows.map { |pair| pair[0] } || lnum != [rows.size, 1].min
+    eprint(tdb, "qry::count")
+    err = true
+  end
+  groups = qry.aggregate(nil, :count, :group_by => "text")
+  gnum = 0
+  groups.each_value { |num| gnum += num } if groups
+  if qry.aggregate(nil, :count) != rows.size || !groups || gnum != rows.size ||
+      rows.any? { |pkey, cols| !groups.has_key?(cols["text"]) }
+    eprint(tdb, "qry::aggregate")
+    err = true
+  end
+  begin
+    qry.aggregate(nil, :sum)
+    eprint(tdb, "qry::aggregate")
+    err = true
+  rescue ArgumentError
+  end
+  if !tdb.sync
+    eprint(tdb, "sync")
+    err = true
+  end
+  rtdb = TDB::new
+  if !rtdb.open(path, TDB::OREADER | TDB::ONOLCK)
+    eprint(rtdb, "open")
+    err = true
+  end
+  rqry = TDBQRY::new(rtdb)
+  rqry.addcond("text", TDBQRY::QCSTRBW, "1")
+  qnum = rqry.count
+  rgroups = rqry.aggregate(nil, :count, :group_by => "text")
+  gnum = 0
+  rgroups.each_value { |num| gnum += num } if rgroups
+  if rqry.aggregate(nil, :count) != qnum || !rgroups || gnum != qnum || (rows.size > 0 && qnum < 1)
+    eprint(rtdb, "qry::aggregate")
+    err = true
+  end
+  if !rtdb.close
+    eprint(rtdb, "close")
+    err = true
+  end
   if !tdb.vanish
     eprint(tdb, "vanish")
     err = true
@@ -746,6 +863,34 @@ def procmisc(path, rnum, opts, omode)
       end
     end
   end
+  printf("checking multiple retrieval:\n")
+  if !tdb.put("mget:1", { "name" => "one", "num" => "1" }) || !tdb.put("mget:2", { "name" => "two" }) ||
+      tdb.mget(["mget:1", "mget:2", "mget:3"]) !=
+      { "mget:1" => { "name" => "one", "num" => "1" }, "mget:2" => { "name" => "two" } } ||
+      tdb.mget(["mget:1"], :columns => ["num"]) != { "mget:1" => { "num" => "1" } }
+    eprint(tdb, "mget")
+    err = true
+  end
+  printf("checking bulk removal:\n")
+  res = tdb.mout(["mget:1", "mget:none"], :transactional => false)
+  if res != [1, ["mget:none"]] || tdb.get("mget:1") || !tdb.get("mget:2")
+    eprint(tdb, "mout")
+    err = true
+  end
+  printf("checking batch iterator:\n")
+  brecs = []
+  tdb.each_batch(7) do |recs|
+    if recs.size < 1 || recs.size > 7
+      eprint(tdb, "each_batch")
+      err = true
+      break
+    end
+    brecs.concat(recs)
+  end
+  if brecs.size != tdb.rnum || brecs != tdb.each.to_a
+    eprint(tdb, "each_batch")
+    err = true
+  end
   printf("checking hash-like iterator:\n")
   inum = 0
   tdb.each do |tkey, tvalue|
@@ -1,4 +1,4 @@
-#! /usr/local/bin/macruby
+#! /usr/bin/env ruby
 
 require 'rbconfig'
 
@@ -36,7 +36,7 @@ commands = [
             "tcatest.rb remove 'casket.tch#mode=w'",
             "tcatest.rb misc 'casket.tch#mode=wct' 1000",
            ]
-rubycmd = Config::CONFIG["bindir"] + "/" + RbConfig::CONFIG['ruby_install_name']
+rubycmd = RbConfig::CONFIG["bindir"] + "/" + RbConfig::CONFIG["ruby_install_name"]
 num = 1
 commands.each do |command|
   rv = system("#{rubycmd} #{command} >/dev/null")
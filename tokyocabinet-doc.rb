@@ -19,7 +19,8 @@ module TokyoCabinet
   # the version information
   VERSION = "x.y.z"
   # Hash database is a file containing a hash table and is handled with the hash database API.  Before operations to store or retrieve records, it is necessary to open a database file and connect the hash database object to it.  To avoid data missing or corruption, it is important to close every database file when it is no longer in use.  It is forbidden for multible database objects in a process to open the same database at the same time.%%
-  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.%%
+  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.  Called without a block, the iterators return an enumerator, and `keys' and `values' return enumerators instead of arrays; records are read from the database on demand, so `db.keys.lazy.select { ... }.first(10)' reads only as many records as it needs.%%
+  # The iterators and the enumerators returned by `keys' and `values' share the iterator of the database with `iterinit' and `iternext'.  Calling any of them inside the block, or walking two enumerators at once as in `db.keys.zip(db.values)', restarts the iteration, so take a snapshot with `to_a' first when it is needed.  Removing the record being yielded is safe.%%
   class HDB
     # error code: success
     ESUCCESS = 0
@@ -92,8 +93,9 @@ module TokyoCabinet
     # open mode: synchronize every transaction
     OTSYNC = 1 << 6
     # Create a hash database object.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:threadsafe' is mapped to `false', the internal mutex is not set and the object is owned by the calling thread; any other thread using the object gets a `ThreadError'.  This saves the locking cost of every method call when the object is never shared.%%
     # The return value is the new hash database object.%%
-    def initialize()
+    def initialize(opts)
       # (native code)
     end
     # Get the message string corresponding to an error code.%%
@@ -183,18 +185,47 @@ module TokyoCabinet
     def putasync(key, value)
       # (native code)
     end
+    # Store multiple records at once.%%
+    # `<i>recs</i>' specifies a hash or an array of key and value pairs.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  The key `:mode' selects how each record is stored: `:put' to overwrite an existing record, `:keep' to keep it, or `:cat' to concatenate the value to it.  The default is `:put'.  If the key `:transactional' is mapped to `false', the records are stored without a transaction.  By default, the whole batch is stored in one transaction.%%
+    # If successful, the return value is an array of the number of stored records and an array of the keys that were not stored.  `nil' is returned if the transaction could not be begun or committed.%%
+    def put_all(recs, opts)
+      # (native code)
+    end
     # Remove a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is true, else, it is false.%%
     def out(key)
       # (native code)
     end
+    # Remove multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:transactional' is mapped to `false', the records are removed without a transaction.  By default, the whole batch is removed in one transaction.%%
+    # If successful, the return value is an array of the number of removed records and an array of the keys which had no corresponding record.  `nil' is returned if the transaction could not be begun or committed, or if a removal failed for another reason than a missing record.%%
+    def mout(keys, opts)
+      # (native code)
+    end
     # Retrieve a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is the value of the corresponding record.  `nil' is returned if no record corresponds.%%
     def get(key)
       # (native code)
     end
+    # Retrieve multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # The return value is a hash mapping each key which has a corresponding record to its value.  Missing records are omitted.%%
+    # This method is faster than calling `get' for each key because the database object is looked up once and the result is built in one native call.%%
+    def mget(keys)
+      # (native code)
+    end
+    # Retrieve a record into a buffer.%%
+    # `<i>key</i>' specifies the key.%%
+    # `<i>buf</i>' specifies a mutable string which receives the value.  It is enlarged only when it is too small for the value.  It must not be the key itself.%%
+    # If successful, the return value is `<i>buf</i>' holding the value of the corresponding record.  `nil' is returned if no record corresponds, and `<i>buf</i>' is left unchanged.%%
+    # Reusing the same buffer in a loop avoids allocating a new string for each lookup.  The value is copied with `tchdbget3' without intermediate allocation.%%
+    def get_into(key, buf)
+      # (native code)
+    end
     # Get the size of the value of a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is the size of the value of the corresponding record, else, it is -1.%%
@@ -213,6 +244,14 @@ module TokyoCabinet
     def iternext()
       # (native code)
     end
+    # Get a page of records from a position token.%%
+    # `<i>token</i>' specifies the position token returned by the previous call.  If it is not defined, the scan begins from the first record.%%
+    # `<i>max</i>' specifies the maximum number of records to be fetched.  If it is not defined or negative, no limit is specified.%%
+    # If successful, the return value is an array of an array of pairs of the key and the value, and the token of the position of the next record.  The token is `nil' when no record remains.  `nil' is returned on failure, for example if the record at the token has been removed.%%
+    # The token is an opaque string.  Every call moves the iterator of the database to the token and puts it back before returning, so independent scans can be interleaved and resumed across calls without keeping any state in the object, and they do not disturb `iternext'.  Resuming does not scan from the beginning.%%
+    def scan(token, max)
+      # (native code)
+    end
     # Get forward matching keys.%%
     # `<i>prefix</i>' specifies the prefix of the corresponding keys.%%
     # `<i>max</i>' specifies the maximum number of keys to be fetched.  If it is not defined or negative, no limit is specified.%%
@@ -298,9 +337,33 @@ module TokyoCabinet
     def fsiz()
       # (native code)
     end
+    # Iterate over records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the key and the value, holding `<i>num</i>' records except for the last batch.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # This method crosses between Ruby and native code once per batch rather than once per record, which saves the dispatching cost on large scans.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Iterate over records with multiple native threads.%%
+    # `<i>opts</i>' specifies options by a hash.  `:threads' specifies the number of worker threads.  If it is not defined, the number of online processors is specified.%%
+    # The block is called with the key and the value of each record in no particular order.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # Worker threads fetch and decompress records concurrently and pass them to the calling thread through a bounded queue.  The block is always called in the calling thread.  The database must not be closed while the method is running.  If the object is in single-owner mode, records are fetched in the calling thread.%%
+    # The workers walk the records with the iterator of the database object, the same one used by `iterinit', `iternext', `each', `keys', `values', `each_batch', and `scan'.  Calling any of them in the block or in another thread while the method is running moves that iterator, so records may be skipped or yielded twice.  If the block has to iterate, take `keys.to_a' before the call.%%
+    def parallel_each(opts)
+      # (native code)
+    end
+    # Iterate over records with values yielded as views.%%
+    # `<i>opts</i>' specifies options by a hash.  If the key `:view' is mapped to true, each value is yielded as a read-only `TokyoCabinet::View' object referring to the buffer of the database engine instead of a new string.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # A view is valid only while the block is running.  Call `to_s' on it to keep the value afterwards.  The same option is accepted by `each_value'.%%
+    def each(opts)
+      # (native code)
+    end
   end
   # B+ tree database is a file containing a B+ tree and is handled with the B+ tree database API.  Before operations to store or retrieve records, it is necessary to open a database file and connect the B+ tree database object to it.  To avoid data missing or corruption, it is important to close every database file when it is no longer in use.  It is forbidden for multible database objects in a process to open the same database at the same time.%%
-  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.%%
+  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.  Called without a block, the iterators return an enumerator, and `keys' and `values' return enumerators instead of arrays; records are read from the database on demand, so `db.keys.lazy.select { ... }.first(10)' reads only as many records as it needs.%%
+  # Each iteration and each enumerator returned by `keys' and `values' walks a cursor of its own, so they can be nested or walked at once.  Records are read ahead in chunks of a few hundred, and each chunk starts from the first key after the last key of the previous one, so records may be stored or removed inside the block as with a snapshot of the keys.  A record removed after it was read ahead is still yielded.%%
   class BDB
     # error code: success
     ESUCCESS = 0
@@ -381,8 +444,9 @@ module TokyoCabinet
     # open mode: synchronize every transaction
     OTSYNC = 1 << 6
     # Create a B+ tree database object.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:threadsafe' is mapped to `false', the internal mutex is not set and the object is owned by the calling thread; any other thread using the object or its cursors gets a `ThreadError'.  This saves the locking cost of every method call when the object is never shared.%%
     # The return value is the new B+ tree database object.%%
-    def initialize()
+    def initialize(opts)
       # (native code)
     end
     # Get the message string corresponding to an error code.%%
@@ -404,6 +468,18 @@ module TokyoCabinet
     def setcmpfunc(cmp)
       # (native code)
     end
+    # Set the codec of integer keys.%%
+    # `<i>codec</i>' specifies the codec: `:int64' for 64-bit binary, `:int32' for 32-bit binary, or `nil' for decimal strings (default).%%
+    # The return value is the codec.%%
+    # Integer keys are packed in the native byte order on the way in, and keys of the matching size are unpacked to integers on the way out by `get', `range', `fwmkeys', `each', `keys', and `TokyoCabinet::BDBCUR#key' and so on.  String keys are passed as they are.  The codec should be used with the comparison function `TokyoCabinet::BDB::CMPINT64' or `TokyoCabinet::BDB::CMPINT32' respectively.%%
+    def key_codec=(codec)
+      # (native code)
+    end
+    # Get the codec of integer keys.%%
+    # The return value is `:int64', `:int32', or `nil'.%%
+    def key_codec()
+      # (native code)
+    end
     # Set the tuning parameters.%%
     # `<i>lmemb</i>' specifies the number of members in each leaf page.  If it is not defined or not more than 0, the default value is specified.  The default value is 128.%%
     # `<i>nmemb</i>' specifies the number of members in each non-leaf page.  If it is not defined or not more than 0, the default value is specified.  The default value is 256.%%
@@ -490,6 +566,21 @@ module TokyoCabinet
     def putlist(key, values)
       # (native code)
     end
+    # Store multiple records at once.%%
+    # `<i>recs</i>' specifies a hash or an array of key and value pairs.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  The key `:mode' selects how each record is stored: `:put' to overwrite an existing record, `:keep' to keep it, or `:cat' to concatenate the value to it.  The default is `:put'.  If the key `:transactional' is mapped to `false', the records are stored without a transaction.  By default, the whole batch is stored in one transaction.%%
+    # If successful, the return value is an array of the number of stored records and an array of the keys that were not stored.  `nil' is returned if the transaction could not be begun or committed.%%
+    def put_all(recs, opts)
+      # (native code)
+    end
+    # Load records given in the order of keys.%%
+    # `<i>recs</i>' specifies an array of key and value pairs, or an object whose `each' method yields them, such as another B+ tree database object.  Records should be sorted by the comparison function of the database.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:dup' is mapped to `true', a record with an existing key is added as a duplicate, which keeps every record when loading from a database with duplicated keys.  By default, an existing record is overwritten.  If the key `:transactional' is mapped to `false', the records are stored without a transaction.  By default, the whole load is done in one transaction.%%
+    # If successful, the return value is an array of the number of stored records and the number of records which were out of order.  `nil' is returned if a record could not be stored or if the transaction could not be begun or committed.  If a record could not be stored or an exception is raised, the transaction is aborted and no record is stored.  Without a transaction, the records stored so far are kept.%%
+    # Records are stored one after another by the normal storing function in a single native loop, because the library has no interface to build leaves directly.  While the keys are in order, the leaf written last is found in the cache, so most records do not search the tree.%%
+    def bulk_load(recs, opts)
+      # (native code)
+    end
     # Remove a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is true, else, it is false.%%
@@ -504,6 +595,13 @@ module TokyoCabinet
     def outlist(key)
       # (native code)
     end
+    # Remove multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:transactional' is mapped to `false', the records are removed without a transaction.  By default, the whole batch is removed in one transaction.  If the key `:dup' is mapped to `true', all records of each duplicated key are removed; otherwise only the first one is.%%
+    # If successful, the return value is an array of the number of removed records and an array of the keys which had no corresponding record.  `nil' is returned if the transaction could not be begun or committed, or if a removal failed for another reason than a missing record.%%
+    def mout(keys, opts)
+      # (native code)
+    end
     # Retrieve a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is the value of the corresponding record.  `nil' is returned if no record corresponds.%%
@@ -511,6 +609,21 @@ module TokyoCabinet
     def get(key)
       # (native code)
     end
+    # Retrieve multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # The return value is a hash mapping each key which has a corresponding record to its value.  Missing records are omitted.  If the key of duplicated records is specified, the value of the first one is selected.%%
+    # This method is faster than calling `get' for each key because the database object is looked up once and the result is built in one native call.%%
+    def mget(keys)
+      # (native code)
+    end
+    # Retrieve a record into a buffer.%%
+    # `<i>key</i>' specifies the key.%%
+    # `<i>buf</i>' specifies a mutable string which receives the value.  It is enlarged only when it is too small for the value.  It must not be the key itself.%%
+    # If successful, the return value is `<i>buf</i>' holding the value of the corresponding record.  `nil' is returned if no record corresponds, and `<i>buf</i>' is left unchanged.%%
+    # Reusing the same buffer in a loop avoids allocating a new string for each lookup.  If the key of duplicated records is specified, the value of the first one is selected.%%
+    def get_into(key, buf)
+      # (native code)
+    end
     # Retrieve records.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is a list object of the values of the corresponding records.  `nil' is returned if no record corresponds.%%
@@ -536,8 +649,9 @@ module TokyoCabinet
     # `<i>ekey</i>' specifies the key of the ending border.  If it is not defined, the last record is specified.%%
     # `<i>einc</i>' specifies whether the ending border is inclusive or not.  If it is not defined, false is specified.%%
     # `<i>max</i>' specifies the maximum number of keys to be fetched.  If it is not defined or negative, no limit is specified.%%
+    # `<i>opts</i>' specifies options by a hash.  If `:reverse' is true, keys are fetched in descending order from the ending border, so that `<i>max</i>' selects the last ones.%%
     # The return value is a list object of the keys of the corresponding records.  This method does never fail.  It returns an empty list even if no record corresponds.%%
-    def range(bkey, binc, ekey, einc, max)
+    def range(bkey, binc, ekey, einc, max, opts)
       # (native code)
     end
     # Get forward matching keys.%%
@@ -626,6 +740,38 @@ module TokyoCabinet
     def fsiz()
       # (native code)
     end
+    # Iterate over records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the key and the value, holding `<i>num</i>' records except for the last batch.  Records are yielded in the order of keys.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # This method crosses between Ruby and native code once per batch rather than once per record, which saves the dispatching cost on large scans.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Iterate over records with values yielded as views.%%
+    # `<i>opts</i>' specifies options by a hash.  If the key `:view' is mapped to true, each value is yielded as a read-only `TokyoCabinet::View' object referring to the buffer of the database engine instead of a new string.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # A view is valid only while the block is running.  Call `to_s' on it to keep the value afterwards.  The same option is accepted by `each_value'.%%
+    def each(opts)
+      # (native code)
+    end
+    # Iterate over ranged records.%%
+    # `<i>bkey</i>' specifies the key of the beginning border.  If it is not defined, the first record is specified.%%
+    # `<i>binc</i>' specifies whether the beginning border is inclusive or not.  If it is not defined, false is specified.%%
+    # `<i>ekey</i>' specifies the key of the ending border.  If it is not defined, the last record is specified.%%
+    # `<i>einc</i>' specifies whether the ending border is inclusive or not.  If it is not defined, false is specified.%%
+    # `<i>opts</i>' specifies options by a hash.  `:limit' specifies the maximum number of records to be fetched.  If `:reverse' is true, records are fetched from the ending border toward the beginning border.  `:view' is the same as that of `each'.%%
+    # The block is called with the key and the value of each record including duplicated ones.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # Unlike `range' followed by `get' for each key, this method walks leaves with a cursor and fetches each value in the same step.%%
+    def each_range(bkey, binc, ekey, einc, opts)
+      # (native code)
+    end
+    # Iterate over records in descending order.%%
+    # `<i>opts</i>' specifies options by a hash.  `:limit' specifies the maximum number of records to be fetched.  `:view' is the same as that of `each'.%%
+    # The block is called with the key and the value of each record from the last one.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    def each_reverse(opts)
+      # (native code)
+    end
   end
   # Cursor is a mechanism to access each record of B+ tree database in ascending or descending order.%%
   class BDBCUR
@@ -693,9 +839,24 @@ module TokyoCabinet
     def val()
       # (native code)
     end
+    # Get records from the cursor forward.%%
+    # `<i>num</i>' specifies the maximum number of records.%%
+    # The return value is an array of pairs of the key and the value, beginning with the record where the cursor is.  It is empty if the cursor is at invalid position.%%
+    # The cursor is moved past the fetched records, so that the next call returns the following page.%%
+    def next_n(num)
+      # (native code)
+    end
+    # Get records from the cursor backward.%%
+    # `<i>num</i>' specifies the maximum number of records.%%
+    # The return value is an array of pairs of the key and the value, beginning with the record where the cursor is and going to the previous ones.  It is empty if the cursor is at invalid position.%%
+    # The cursor is moved past the fetched records, so that the next call returns the preceding page.%%
+    def prev_n(num)
+      # (native code)
+    end
   end
   # Fixed-Length database is a file containing a fixed-length table and is handled with the fixed-length database API.  Before operations to store or retrieve records, it is necessary to open a database file and connect the fixed-length database object to it.  To avoid data missing or corruption, it is important to close every database file when it is no longer in use.  It is forbidden for multible database objects in a process to open the same database at the same time.%%
-  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.%%
+  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.  Called without a block, the iterators return an enumerator, and `keys' and `values' return enumerators instead of arrays; records are read from the database on demand, so `db.keys.lazy.select { ... }.first(10)' reads only as many records as it needs.%%
+  # The iterators and the enumerators returned by `keys' and `values' share the iterator of the database with `iterinit' and `iternext'.  Calling any of them inside the block, or walking two enumerators at once as in `db.keys.zip(db.values)', restarts the iteration, so take a snapshot with `to_a' first when it is needed.  Removing the record being yielded is safe.%%
   class FDB
     # error code: success
     ESUCCESS = 0
@@ -758,8 +919,9 @@ module TokyoCabinet
     # open mode: lock without blocking
     OLCKNB = 1 << 5
     # Create a fixed-length database object.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:threadsafe' is mapped to `false', the internal mutex is not set and the object is owned by the calling thread; any other thread using the object gets a `ThreadError'.  This saves the locking cost of every method call when the object is never shared.%%
     # The return value is the new fixed-length database object.%%
-    def initialize()
+    def initialize(opts)
       # (native code)
     end
     # Get the message string corresponding to an error code.%%
@@ -818,18 +980,54 @@ module TokyoCabinet
     def putcat(key, value)
       # (native code)
     end
+    # Store multiple records at once.%%
+    # `<i>recs</i>' specifies a hash or an array of key and value pairs.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  The key `:mode' selects how each record is stored: `:put' to overwrite an existing record, `:keep' to keep it, or `:cat' to concatenate the value to it.  The default is `:put'.  If the key `:transactional' is mapped to `false', the records are stored without a transaction.  By default, the whole batch is stored in one transaction.%%
+    # If successful, the return value is an array of the number of stored records and an array of the keys that were not stored.  `nil' is returned if the transaction could not be begun or committed.%%
+    def put_all(recs, opts)
+      # (native code)
+    end
     # Remove a record.%%
     # `<i>key</i>' specifies the key.  It should be more than 0.  If it is `FDBIDMIN', the minimum ID number of existing records is specified.  If it is `FDBIDMAX', the maximum ID number of existing records is specified.%%
     # If successful, the return value is true, else, it is false.%%
     def out(key)
       # (native code)
     end
+    # Remove multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:transactional' is mapped to `false', the records are removed without a transaction.  By default, the whole batch is removed in one transaction.%%
+    # If successful, the return value is an array of the number of removed records and an array of the keys which had no corresponding record.  `nil' is returned if the transaction could not be begun or committed, or if a removal failed for another reason than a missing record.%%
+    def mout(keys, opts)
+      # (native code)
+    end
     # Retrieve a record.%%
     # `<i>key</i>' specifies the key.  It should be more than 0.  If it is `FDBIDMIN', the minimum ID number of existing records is specified.  If it is `FDBIDMAX', the maximum ID number of existing records is specified.%%
     # If successful, the return value is the value of the corresponding record.  `nil' is returned if no record corresponds.%%
     def get(key)
       # (native code)
     end
+    # Retrieve multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # The return value is a hash mapping each key which has a corresponding record to its value.  Missing records are omitted.%%
+    # This method is faster than calling `get' for each key because the database object is looked up once and the result is built in one native call.%%
+    def mget(keys)
+      # (native code)
+    end
+    # Retrieve a record into a buffer.%%
+    # `<i>key</i>' specifies the key.%%
+    # `<i>buf</i>' specifies a mutable string which receives the value.  It is enlarged only when it is too small for the value.  It must not be the key itself.%%
+    # If successful, the return value is `<i>buf</i>' holding the value of the corresponding record.  `nil' is returned if no record corresponds, and `<i>buf</i>' is left unchanged.%%
+    # Reusing the same buffer in a loop avoids allocating a new string for each lookup.  The buffer is grown to the width of the database once, so later calls do no allocation.%%
+    def get_into(key, buf)
+      # (native code)
+    end
+    # Retrieve a record by an ID number.%%
+    # `<i>id</i>' specifies the ID number as an integer.%%
+    # If successful, the return value is the value of the corresponding record.  `nil' is returned if no record corresponds.%%
+    # Unlike `get', the key is not converted from a string.%%
+    def get_id(id)
+      # (native code)
+    end
     # Get the size of the value of a record.%%
     # `<i>key</i>' specifies the key.  It should be more than 0.  If it is `FDBIDMIN', the minimum ID number of existing records is specified.  If it is `FDBIDMAX', the maximum ID number of existing records is specified.%%
     # If successful, the return value is the size of the value of the corresponding record, else, it is -1.%%
@@ -848,6 +1046,12 @@ module TokyoCabinet
     def iternext()
       # (native code)
     end
+    # Get the next ID number of the iterator.%%
+    # If successful, the return value is the next ID number as an integer, else, it is `nil'.  `nil' is returned when no record is to be get out of the iterator.%%
+    # This method is the same as `iternext' except that the ID number is not formatted as a string.%%
+    def iternext_id()
+      # (native code)
+    end
     # Get keys with an interval notation.%%
     # `<i>interval</i>' specifies the interval notation.%%
     # `<i>max</i>' specifies the maximum number of keys to be fetched.  If it is not defined or negative, no limit is specified.%%
@@ -855,6 +1059,14 @@ module TokyoCabinet
     def range(interval, max)
       # (native code)
     end
+    # Get ID numbers in a range.%%
+    # `<i>lower</i>' specifies the lower limit of the range.  If it is not defined, the minimum ID is specified.%%
+    # `<i>upper</i>' specifies the upper limit of the range.  If it is not defined, the maximum ID is specified.%%
+    # `<i>max</i>' specifies the maximum number of ID numbers to be fetched.  If it is not defined or negative, no limit is specified.%%
+    # The return value is an array of the ID numbers as integers.  This method does never fail.  It returns an empty array even if no record corresponds.%%
+    def range_ids(lower, upper, max)
+      # (native code)
+    end
     # Add an integer to a record.%%
     # `<i>key</i>' specifies the key.  It should be more than 0.  If it is "min", the minimum ID number of existing records is specified.  If it is "prev", the number less by one than the minimum ID number of existing records is specified.  If it is "max", the maximum ID number of existing records is specified.  If it is "next", the number greater by one than the maximum ID number of existing records is specified.%%
     # `<i>num</i>' specifies the additional value.%%
@@ -929,9 +1141,32 @@ module TokyoCabinet
     def fsiz()
       # (native code)
     end
+    # Iterate over records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the key and the value, holding `<i>num</i>' records except for the last batch.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # This method crosses between Ruby and native code once per batch rather than once per record, which saves the dispatching cost on large scans.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Iterate over records with ID numbers.%%
+    # The block is called with the ID number as an integer and the value of each record in ascending order of the ID number.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    def each_id()
+      # (native code)
+    end
+    # Iterate over records in a range of ID numbers.%%
+    # `<i>lower</i>' specifies the lower limit of the range.  If it is not defined, the minimum ID is specified.%%
+    # `<i>upper</i>' specifies the upper limit of the range.  If it is not defined, the maximum ID is specified.%%
+    # The block is called with the ID number as an integer and the value of each record.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # ID numbers are fetched by chunks and values are read into a buffer of the width of the database, so that no string is formatted or allocated except for the yielded values.%%
+    def each_id_range(lower, upper)
+      # (native code)
+    end
   end
   # Table database is a file containing records composed of the primary keys and arbitrary columns and is handled with the table database API.  Before operations to store or retrieve records, it is necessary to open a database file and connect the table database object to it.  To avoid data missing or corruption, it is important to close every database file when it is no longer in use.  It is forbidden for multible database objects in a process to open the same database at the same time.%%
-  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.%%
+  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.  Called without a block, the iterators return an enumerator, and `keys' and `values' return enumerators instead of arrays; records are read from the database on demand, so `db.keys.lazy.select { ... }.first(10)' reads only as many records as it needs.%%
+  # The iterators and the enumerators returned by `keys' and `values' share the iterator of the database with `iterinit' and `iternext'.  Calling any of them inside the block, or walking two enumerators at once as in `db.keys.zip(db.values)', restarts the iteration, so take a snapshot with `to_a' first when it is needed.  Removing the record being yielded is safe.%%
   class TDB
     # error code: success
     ESUCCESS = 0
@@ -1018,8 +1253,9 @@ module TokyoCabinet
     # index type: keep existing index
     ITKEEP = 1 << 24
     # Create a table database object.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:threadsafe' is mapped to `false', the internal mutex is not set and the object is owned by the calling thread; any other thread using the object or its queries gets a `ThreadError'.  This saves the locking cost of every method call when the object is never shared.%%
     # The return value is the new table database object.%%
-    def initialize()
+    def initialize(opts)
       # (native code)
     end
     # Get the message string corresponding to an error code.%%
@@ -1109,10 +1345,26 @@ module TokyoCabinet
     def out(pkey)
       # (native code)
     end
+    # Remove multiple records at once.%%
+    # `<i>pkeys</i>' specifies an array of the primary keys.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:transactional' is mapped to `false', the records are removed without a transaction.  By default, the whole batch is removed in one transaction.%%
+    # If successful, the return value is an array of the number of removed records and an array of the primary keys which had no corresponding record.  `nil' is returned if the transaction could not be begun or committed, or if a removal failed for another reason than a missing record.%%
+    def mout(pkeys, opts)
+      # (native code)
+    end
     # Retrieve a record.%%
     # `<i>pkey</i>' specifies the primary key.%%
+    # `<i>opts</i>' specifies options by a hash.  If the key `:columns' is mapped to an array of column names, only the specified columns are converted into the result.  If it is not defined, every column is converted.%%
     # If successful, the return value is a hash of the columns of the corresponding record.  `nil' is returned if no record corresponds.%%
-    def get(pkey)
+    def get(pkey, opts)
+      # (native code)
+    end
+    # Retrieve multiple records at once.%%
+    # `<i>pkeys</i>' specifies an array of the primary keys.%%
+    # `<i>opts</i>' specifies options by a hash.  `:columns' is the same as that of `get'.%%
+    # The return value is a hash mapping each primary key which has a corresponding record to its hash of columns.  Missing records are omitted.%%
+    # This method is faster than calling `get' for each primary key because the database object is looked up once and the result is built in one native call.%%
+    def mget(pkeys, opts)
       # (native code)
     end
     # Get the size of the value of a record.%%
@@ -1230,8 +1482,23 @@ module TokyoCabinet
     def genuid()
       # (native code)
     end
+    # Iterate over records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the primary key and a hash of the columns, holding `<i>num</i>' records except for the last batch.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # This method crosses between Ruby and native code once per batch rather than once per record, which saves the dispatching cost on large scans.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Iterate over records with projected columns.%%
+    # `<i>opts</i>' specifies options by a hash.  `:columns' is the same as that of `get'.%%
+    # The block is called with the primary key and the hash of columns of each record.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    def each(opts)
+      # (native code)
+    end
   end
   # Query is a mechanism to search for and retrieve records corresponding conditions from table database.%%
+  # A search of `search', `search_rows', `count', `each', `each_batch', and `aggregate' may run while other Ruby threads run.  While it runs, every method of the same query object called from another thread raises `ThreadError'.  Use a query object per thread to search concurrently.%%
   class TDBQRY
     # query condition: string is equal to
     QCSTREQ = 0
@@ -1338,14 +1605,49 @@ module TokyoCabinet
     def search()
       # (native code)
     end
+    # Execute the search and retrieve the corresponding records.%%
+    # `<i>opts</i>' specifies options by a hash.  `:columns' is the same as that of `TDB#get'.%%
+    # The return value is an array of pairs of the primary key and the hash of columns of the corresponding records.  This method does never fail.  It returns an empty array even if no record corresponds.%%
+    def search_rows(opts)
+      # (native code)
+    end
+    # Get the number of the corresponding records.%%
+    # The return value is the number of the corresponding records, which is the same as the size of the result of `search'.  This method does never fail.%%
+    # No Ruby object is created for the primary keys.  As with `search', the limit and the skip set by `setlimit' are applied, so call `setlimit' without arguments first to get the total number of records for pagination.%%
+    def count()
+      # (native code)
+    end
+    # Iterate over the corresponding records.%%
+    # The block is called with the primary key and the hash of columns of each corresponding record.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # The primary keys of the result are collected by the native search first, without creating Ruby objects for them.  Then the records are read in chunks of 256 and yielded while no lock is held, so the block may access the database object and the whole result set is never built as Ruby objects.  Breaking the block stops reading the remaining records.  A record removed after the search is skipped, and a record modified after the search is yielded as it is read.%%
+    def each()
+      # (native code)
+    end
+    # Iterate over the corresponding records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the primary key and the hash of columns, holding `<i>num</i>' records except for the last batch.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # Records are read the same way as `each', so the block may access the database object.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Aggregate a column of the corresponding records.%%
+    # `<i>name</i>' specifies the name of the column.  If it is `nil', only the number of records is counted, and `<i>func</i>' must be `:count', otherwise `ArgumentError' is raised.%%
+    # `<i>func</i>' specifies the aggregate function: `:count', `:sum', `:min', `:max', or `:avg'.  Column values are parsed as real numbers.%%
+    # `<i>opts</i>' specifies options by a hash.  `:group_by' specifies the name of the column to group records by.%%
+    # The return value is the aggregated value.  `:count' yields an integer and the others yield a real number or `nil' if no value is aggregated.  If `:group_by' is specified, the return value is a hash of each group value and its aggregated value, where the key of records without the grouping column is `nil'.%%
+    # After the search, records are read one by one and aggregated in the native layer, so no Ruby object is created for each record.  The table is not locked for writing, so this method works on a database opened as a reader and does not block other readers.%%
+    def aggregate(name, func, opts)
+      # (native code)
+    end
     # Remove each corresponding record.%%
     # If successful, the return value is true, else, it is false.%%
     def searchout()
       # (native code)
     end
     # Process each corresponding record.%%
-    # This method needs a block parameter of the iterator called for each record.  The block receives two parameters.  The first parameter is the primary key.  The second parameter is a hash containing columns.  It returns flags of the post treatment by bitwise-or: `TokyoCabinet::TDBQRY::QPPUT' to modify the record, `TokyoCabinet::TDBQRY::QPOUT' to remove the record, `TokyoCabinet::TDBQRY::QPSTOP' to stop the iteration.%%
+    # This method needs a block parameter of the iterator called for each record.  The block receives two parameters.  The first parameter is the primary key.  The second parameter is a row object of `TokyoCabinet::TDBQRY::Row' containing columns.  It returns flags of the post treatment by bitwise-or: `TokyoCabinet::TDBQRY::QPPUT' to modify the record, `TokyoCabinet::TDBQRY::QPOUT' to remove the record, `TokyoCabinet::TDBQRY::QPSTOP' to stop the iteration.%%
     # If successful, the return value is true, else, it is false.%%
+    # The row refers to the columns in the native layer, so only the columns read in the block are converted into strings and the columns written in the block are stored directly.  If no column is written, `TokyoCabinet::TDBQRY::QPPUT' is ignored.  If an exception is raised in the block, the iteration is stopped and the exception is propagated.%%
     def proc()
       # (native code)
     end
@@ -1373,7 +1675,8 @@ module TokyoCabinet
     end
   end
   # Abstract database is a set of interfaces to use on-memory hash database, on-memory tree database, hash database, B+ tree database, fixed-length database, and table database with the same API.  Before operations to store or retrieve records, it is necessary to connect the abstract database object to the concrete one.  The method `open' is used to open a concrete database and the method `close' is used to close the database.  To avoid data missing or corruption, it is important to close every database instance when it is no longer in use.  It is forbidden for multible database objects in a process to open the same database at the same time.%%
-  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.%%
+  # Except for the interface below, methods compatible with the `Hash' class are also provided; `[]', `[]=', `store', `delete', `fetch', `has_key?', `has_value?', `key', `clear', `size', `empty?', `each', `each_key', `each_value', and `keys'.  Called without a block, the iterators return an enumerator, and `keys' and `values' return enumerators instead of arrays; records are read from the database on demand, so `db.keys.lazy.select { ... }.first(10)' reads only as many records as it needs.%%
+  # The iterators and the enumerators returned by `keys' and `values' share the iterator of the database with `iterinit' and `iternext'.  Calling any of them inside the block, or walking two enumerators at once as in `db.keys.zip(db.values)', restarts the iteration, so take a snapshot with `to_a' first when it is needed.%%
   class ADB
     # Create an abstract database object.%%
     # The return value is the new abstract database object.%%
@@ -1417,18 +1720,48 @@ module TokyoCabinet
     def putcat(key, value)
       # (native code)
     end
+    # Store multiple records at once.%%
+    # `<i>recs</i>' specifies a hash or an array of key and value pairs.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  The key `:mode' selects how each record is stored: `:put' to overwrite an existing record, `:keep' to keep it, or `:cat' to concatenate the value to it.  The default is `:put'.  If the key `:transactional' is mapped to `false', the records are stored without a transaction.  By default, the whole batch is stored in one transaction.%%
+    # If successful, the return value is an array of the number of stored records and an array of the keys that were not stored.  `nil' is returned if the transaction could not be begun or committed.%%
+    def put_all(recs, opts)
+      # (native code)
+    end
     # Remove a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is true, else, it is false.%%
     def out(key)
       # (native code)
     end
+    # Remove multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # `<i>opts</i>' specifies a hash of options.  If it is not defined, no option is specified.  If the key `:transactional' is mapped to `false', the records are removed without a transaction.  By default, the whole batch is removed in one transaction.%%
+    # If successful, the return value is an array of the number of removed records and an array of the keys which could not be removed.  `nil' is returned if the transaction could not be begun or committed.%%
+    # Because the abstract database does not tell why a removal failed, a key without a corresponding record is not distinguished from one whose removal failed for another reason; both are in the array.%%
+    def mout(keys, opts)
+      # (native code)
+    end
     # Retrieve a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is the value of the corresponding record.  `nil' is returned if no record corresponds.%%
     def get(key)
       # (native code)
     end
+    # Retrieve multiple records at once.%%
+    # `<i>keys</i>' specifies an array of the keys.%%
+    # The return value is a hash mapping each key which has a corresponding record to its value.  Missing records are omitted.%%
+    # This method is faster than calling `get' for each key because the database object is looked up once and the result is built in one native call.%%
+    def mget(keys)
+      # (native code)
+    end
+    # Retrieve a record into a buffer.%%
+    # `<i>key</i>' specifies the key.%%
+    # `<i>buf</i>' specifies a mutable string which receives the value.  It is enlarged only when it is too small for the value.  It must not be the key itself.%%
+    # If successful, the return value is `<i>buf</i>' holding the value of the corresponding record.  `nil' is returned if no record corresponds, and `<i>buf</i>' is left unchanged.%%
+    # Reusing the same buffer in a loop avoids allocating a new string for each lookup.%%
+    def get_into(key, buf)
+      # (native code)
+    end
     # Get the size of the value of a record.%%
     # `<i>key</i>' specifies the key.%%
     # If successful, the return value is the size of the value of the corresponding record, else, it is -1.%%
@@ -1535,5 +1868,170 @@ module TokyoCabinet
     def misc(name, args)
       # (native code)
     end
+    # Iterate over records in batches.%%
+    # `<i>num</i>' specifies the maximum number of records in a batch.%%
+    # The block is called with an array of pairs of the key and the value, holding `<i>num</i>' records except for the last batch.%%
+    # The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # This method crosses between Ruby and native code once per batch rather than once per record, which saves the dispatching cost on large scans.%%
+    def each_batch(num)
+      # (native code)
+    end
+    # Iterate over records with multiple native threads.%%
+    # `<i>opts</i>' specifies options by a hash.  `:threads' specifies the number of worker threads.  If it is not defined, the number of online processors is specified.%%
+    # The block is called with the key and the value of each record in no particular order.  The return value is the value returned by the last call of the block or `nil' if there is no record.%%
+    # Worker threads fetch and decompress records concurrently and pass them to the calling thread through a bounded queue.  The block is always called in the calling thread.  The database must not be closed while the method is running.  Records are fetched in parallel only if the database is a hash database; otherwise this method is the same as `each'.%%
+    # The workers walk the records with the iterator of the database object, the same one used by `iterinit', `iternext', `each', `keys', `values', and `each_batch'.  Calling any of them in the block or in another thread while the method is running moves that iterator, so records may be skipped or yielded twice.  If the block has to iterate, take `keys.to_a' before the call.%%
+    def parallel_each(opts)
+      # (native code)
+    end
+  end
+  # A view is a read-only string-like object referring to a value in the buffer of a database engine.  It is yielded by the iterators of `HDB' and `BDB' when the option `:view' is specified, and saves the cost of copying each value into a new string.%%
+  # A view is valid only while the block it was yielded to is running.  After the block returns, every method except for `valid?' and `inspect' raises `ArgumentError'.%%
+  class View
+    # Get the size of the region.%%
+    # The return value is the size of the region in bytes.  `bytesize' is an alias.%%
+    def size()
+      # (native code)
+    end
+    # Copy the region into a new string.%%
+    # The return value is a new string.  `to_str' is an alias.%%
+    def to_s()
+      # (native code)
+    end
+    # Get a byte of the region.%%
+    # `<i>idx</i>' specifies the index of the byte.  A negative index counts from the end.%%
+    # The return value is the byte as an integer or `nil' if the index is out of the region.%%
+    def getbyte(idx)
+      # (native code)
+    end
+    # Copy a part of the region into a new string.%%
+    # `<i>start</i>' specifies the index of the first byte.  A negative index counts from the end.%%
+    # `<i>len</i>' specifies the number of bytes.  If it is not defined, 1 is specified.%%
+    # The return value is a new string or `nil' if the start index is out of the region.  `[]' is an alias.%%
+    def byteslice(start, len)
+      # (native code)
+    end
+    # Check whether the region begins with a string.%%
+    # `<i>str</i>' specifies the string.%%
+    # The return value is true if the region begins with the string, else, it is false.%%
+    def start_with?(str)
+      # (native code)
+    end
+    # Check whether the region equals to a string or another view.%%
+    # `<i>obj</i>' specifies the string or the view.%%
+    # The return value is true if the contents are the same, else, it is false.%%
+    def ==(obj)
+      # (native code)
+    end
+    # Check whether the view is still valid.%%
+    # The return value is true if the view can be read, else, it is false.%%
+    def valid?()
+      # (native code)
+    end
+  end
+  # A row is a hash-like object referring to the columns of a record being processed by `TDBQRY#proc'.  It includes the module `Enumerable'.%%
+  # A row is valid only while the block it was yielded to is running.  After the block returns, every method except for `valid?' raises `ArgumentError'.  `proc' used to yield a hash, so code which keeps the columns after the block must keep the result of `to_hash' or `dup' instead of the row.%%
+  # Only the methods listed here are provided.  Other methods of `Hash' are not, and the methods of `Enumerable' such as `map' treat the row as a collection of pairs of the name and the value.%%
+  class TDBQRY::Row
+    # Get the value of a column.%%
+    # `<i>name</i>' specifies the name of the column.%%
+    # The return value is the value of the column or `nil' if the column does not exist.%%
+    def [](name)
+      # (native code)
+    end
+    # Get the value of a column or a default.%%
+    # `<i>name</i>' specifies the name of the column.%%
+    # `<i>default</i>' specifies the value returned if the column does not exist.%%
+    # The return value is the value of the column.  If the column does not exist, the block is called with the name if it is given, else `<i>default</i>' is returned if it is given, else `KeyError' is raised.%%
+    def fetch(name, default)
+      # (native code)
+    end
+    # Set the value of a column.%%
+    # `<i>name</i>' specifies the name of the column.%%
+    # `<i>value</i>' specifies the value.%%
+    # The return value is the value.  `store' is an alias.%%
+    def []=(name, value)
+      # (native code)
+    end
+    # Remove a column.%%
+    # `<i>name</i>' specifies the name of the column.%%
+    # The return value is the value of the removed column or `nil' if the column does not exist.%%
+    def delete(name)
+      # (native code)
+    end
+    # Set the values of multiple columns.%%
+    # `<i>hash</i>' specifies a hash of the names and the values of the columns.%%
+    # The return value is the row itself.  `update' is an alias.%%
+    def merge!(hash)
+      # (native code)
+    end
+    # Remove all columns.%%
+    # The return value is the row itself.%%
+    def clear()
+      # (native code)
+    end
+    # Check whether a column exists.%%
+    # `<i>name</i>' specifies the name of the column.%%
+    # The return value is true if the column exists, else, it is false.  `key?', `include?', and `member?' are aliases.%%
+    def has_key?(name)
+      # (native code)
+    end
+    # Get the names of the columns.%%
+    # The return value is an array of the names.%%
+    def keys()
+      # (native code)
+    end
+    # Get the values of the columns.%%
+    # The return value is an array of the values.%%
+    def values()
+      # (native code)
+    end
+    # Get the number of the columns.%%
+    # The return value is the number of the columns.  `length' is an alias.%%
+    def size()
+      # (native code)
+    end
+    # Check whether the row has no column.%%
+    # The return value is true if the row has no column, else, it is false.%%
+    def empty?()
+      # (native code)
+    end
+    # Iterate over the columns.%%
+    # The block is called with the name and the value of each column.  The return value is the row itself.  `each_pair' is an alias.%%
+    def each()
+      # (native code)
+    end
+    # Iterate over the names of the columns.%%
+    # The block is called with the name of each column.  The return value is the row itself.%%
+    def each_key()
+      # (native code)
+    end
+    # Iterate over the values of the columns.%%
+    # The block is called with the value of each column.  The return value is the row itself.%%
+    def each_value()
+      # (native code)
+    end
+    # Select columns.%%
+    # The block is called with the name and the value of each column.%%
+    # The return value is a new hash of the columns for which the block returns true.%%
+    def select()
+      # (native code)
+    end
+    # Reject columns.%%
+    # The block is called with the name and the value of each column.%%
+    # The return value is a new hash of the columns for which the block returns false.%%
+    def reject()
+      # (native code)
+    end
+    # Copy the columns into a new hash.%%
+    # The return value is a new hash of the columns.  `to_h' and `dup' are aliases; the copy stays valid after the block returns.%%
+    def to_hash()
+      # (native code)
+    end
+    # Check whether the row is still valid.%%
+    # The return value is true if the row can be accessed, else, it is false.%%
+    def valid?()
+      # (native code)
+    end
   end
 end
@@ -1,5 +1,5 @@
 /*************************************************************************************************
- * MacRuby binding of Tokyo Cabinet
+ * Ruby binding of Tokyo Cabinet for MacRuby and CRuby
  *                                                      Copyright (C) 2006-2009 Mikio Hirabayashi
  * This file is part of Tokyo Cabinet.
  * Tokyo Cabinet is free software; you can redistribute it and/or modify it under the terms of
@@ -15,6 +15,9 @@
 
 
 #include "ruby.h"
+#if defined(HAVE_RUBY_THREAD_H)
+#include <ruby/thread.h>
+#endif
 #include <tcutil.h>
 #include <tchdb.h>
 #include <tcbdb.h>
@@ -26,15 +29,20 @@
 #include <stdint.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
-#define HDBVNDATA      "@hdb"
 #define BDBVNDATA      "@bdb"
-#define BDBCURVNDATA   "@bdbcur"
-#define FDBVNDATA      "@fdb"
 #define TDBVNDATA      "@tdb"
-#define TDBQRYVNDATA   "@tdbqry"
-#define ADBVNDATA      "@adb"
+#define OWNERVNDATA    "@owner"
 #define NUMBUFSIZ      32
+#define FDBRANGEUNIT   1024
+#define PSCANQUEUE     1024
+#define BDBITERUNIT    256
+#define QRYITERUNIT    256
+#define BATCHUNIT      256
+#define BLOCKBUFSIZ    256
+#define BLOCKVSIZ      16384
 
 #if !defined(RSTRING_PTR)
 #define RSTRING_PTR(TC_s) (RSTRING(TC_s)->ptr)
@@ -42,244 +50,727 @@
 #if !defined(RSTRING_LEN)
 #define RSTRING_LEN(TC_s) (RSTRING(TC_s)->len)
 #endif
+
+#if defined(HAVE_RB_OBJC_DEFINE_METHOD)
+#define RBSELF         VALUE vself, SEL sel
+#define RBVARARGS      VALUE vself, SEL sel, int argc, VALUE *argv
+#else
+#define RBSELF         VALUE vself
+#define RBVARARGS      int argc, VALUE *argv, VALUE vself
+#define rb_objc_define_method(TC_klass, TC_name, TC_func, TC_argc) \
+  rb_define_method((TC_klass), (TC_name), (TC_func), (TC_argc))
+#endif
+#if !defined(RB_BLOCK_CALL_FUNC_ARGLIST)
+#define RB_BLOCK_CALL_FUNC_ARGLIST(TC_yarg, TC_carg) VALUE TC_yarg, VALUE TC_carg, int argc, VALUE *argv
+#endif
 #if !defined(RARRAY_LEN)
 #define RARRAY_LEN(TC_a) (RARRAY(TC_a)->len)
 #endif
 
+#if defined(TypedData_Wrap_Struct)
+#define DATATYPE       rb_data_type_t
+#define WrapDATA(TC_klass, TC_type, TC_ptr) \
+  TypedData_Wrap_Struct((TC_klass), (TC_type), (TC_ptr))
+#define GetDATA(TC_obj, TC_ctype, TC_type, TC_ptr) \
+  TypedData_Get_Struct((TC_obj), TC_ctype, (TC_type), (TC_ptr))
+#else
+typedef struct {                         /* substitute of the type of typed data */
+  const char *wrap_struct_name;          /* name of the type */
+  struct {
+    RUBY_DATA_FUNC dmark;                /* function to mark the data */
+    RUBY_DATA_FUNC dfree;                /* function to free the data */
+  } function;
+} DATATYPE;
+#define WrapDATA(TC_klass, TC_type, TC_ptr) \
+  Data_Wrap_Struct((TC_klass), (TC_type)->function.dmark, (TC_type)->function.dfree, (TC_ptr))
+#define GetDATA(TC_obj, TC_ctype, TC_type, TC_ptr) \
+  Data_Get_Struct((TC_obj), TC_ctype, (TC_ptr))
+#endif
+
+#define CheckOwner(TC_owner) \
+  do { \
+    if((TC_owner) != Qnil && (TC_owner) != rb_thread_current()) \
+      rb_raise(rb_eThreadError, "the database object is owned by another thread"); \
+  } while(false)
+#define GetHDBDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), HDBDATA, &hdb_type, (TC_data)); \
+    CheckOwner((TC_data)->owner); \
+  } while(false)
+#define GetHDB(TC_obj, TC_hdb) \
+  do { \
+    HDBDATA *TC_data; \
+    GetHDBDATA((TC_obj), TC_data); \
+    (TC_hdb) = TC_data->hdb; \
+  } while(false)
+#define GetBDBDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), BDBDATA, &bdb_type, (TC_data)); \
+    CheckOwner((TC_data)->owner); \
+  } while(false)
+#define GetBDB(TC_obj, TC_bdb) \
+  do { \
+    BDBDATA *TC_data; \
+    GetBDBDATA((TC_obj), TC_data); \
+    (TC_bdb) = TC_data->bdb; \
+  } while(false)
+#define GetBDBCURDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), BDBCURDATA, &bdbcur_type, (TC_data)); \
+    if(!(TC_data)->cur) rb_raise(rb_eArgError, "uninitialized cursor"); \
+    CheckOwner((TC_data)->bdata->owner); \
+  } while(false)
+#define GetBDBCUR(TC_obj, TC_cur) \
+  do { \
+    BDBCURDATA *TC_data; \
+    GetBDBCURDATA((TC_obj), TC_data); \
+    (TC_cur) = TC_data->cur; \
+  } while(false)
+#define GetFDBDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), FDBDATA, &fdb_type, (TC_data)); \
+    CheckOwner((TC_data)->owner); \
+  } while(false)
+#define GetFDB(TC_obj, TC_fdb) \
+  do { \
+    FDBDATA *TC_data; \
+    GetFDBDATA((TC_obj), TC_data); \
+    (TC_fdb) = TC_data->fdb; \
+  } while(false)
+#define GetTDBDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), TDBDATA, &tdb_type, (TC_data)); \
+    CheckOwner((TC_data)->owner); \
+  } while(false)
+#define GetTDB(TC_obj, TC_tdb) \
+  do { \
+    TDBDATA *TC_data; \
+    GetTDBDATA((TC_obj), TC_data); \
+    (TC_tdb) = TC_data->tdb; \
+  } while(false)
+#define GetTDBQRYDATA(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), TDBQRYDATA, &tdbqry_type, (TC_data)); \
+    if(!(TC_data)->qry) rb_raise(rb_eArgError, "uninitialized query"); \
+    if((TC_data)->busy) rb_raise(rb_eThreadError, "the query is being searched by another thread"); \
+    CheckOwner((TC_data)->tdata->owner); \
+  } while(false)
+#define GetTDBQRY(TC_obj, TC_qry) \
+  do { \
+    TDBQRYDATA *TC_data; \
+    GetTDBQRYDATA((TC_obj), TC_data); \
+    (TC_qry) = TC_data->qry; \
+  } while(false)
+#define GetADB(TC_obj, TC_adb) GetDATA((TC_obj), TCADB, &adb_type, (TC_adb))
+#define GetVIEW(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), VIEWDATA, &view_type, (TC_data)); \
+    if(!(TC_data)->ptr) rb_raise(rb_eArgError, "expired view"); \
+  } while(false)
+#define GetROW(TC_obj, TC_data) \
+  do { \
+    GetDATA((TC_obj), ROWDATA, &row_type, (TC_data)); \
+    if(!(TC_data)->cols) rb_raise(rb_eArgError, "expired row"); \
+  } while(false)
+
+typedef struct {                         /* type of structure for an encoded argument */
+  VALUE vstr;                            /* string object holding the region, if any */
+  const char *ptr;                       /* pointer to the region */
+  int size;                              /* size of the region */
+  char buf[NUMBUFSIZ];                   /* buffer for numbers and boolean values */
+} VALBUF;
+
+enum {                                   /* enumeration for key codecs */
+  KCSTRING,                              /* keys as they are */
+  KCINT32,                               /* integer keys as 32-bit binary */
+  KCINT64                                /* integer keys as 64-bit binary */
+};
+
+enum {                                   /* enumeration for iteration modes */
+  IMPAIR,                                /* yield a key and a value */
+  IMKEY,                                 /* yield a key */
+  IMVALUE,                               /* yield a value */
+  IMBATCH,                               /* yield arrays of pairs */
+  IMSELECT,                              /* yield a key and a value and keep accepted pairs */
+  IMREJECT                               /* yield a key and a value and keep rejected pairs */
+};
+
+enum {                                   /* enumeration for bulk storing modes */
+  PMPUT,                                 /* overwrite existing records */
+  PMKEEP,                                /* keep existing records */
+  PMCAT                                  /* concatenate to existing records */
+};
+
+enum {                                   /* enumeration for aggregate functions */
+  AFCOUNT,                               /* number of values */
+  AFSUM,                                 /* sum of values */
+  AFMIN,                                 /* minimum value */
+  AFMAX,                                 /* maximum value */
+  AFAVG                                  /* average of values */
+};
+
+typedef struct {                         /* type of structure for a hash database object */
+  TCHDB *hdb;                            /* database object */
+  VALUE owner;                           /* owner thread or nil if thread-safe */
+} HDBDATA;
+
+typedef struct {                         /* type of structure for a B+ tree database object */
+  TCBDB *bdb;                            /* database object */
+  VALUE owner;                           /* owner thread or nil if thread-safe */
+  int kcodec;                            /* key codec */
+} BDBDATA;
+
+typedef struct {                         /* type of structure for a cursor object */
+  BDBCUR *cur;                           /* cursor object */
+  BDBDATA *bdata;                        /* data of the database object */
+} BDBCURDATA;
+
+typedef struct {                         /* type of structure for a bulk loading */
+  BDBDATA *data;                         /* data of the database object */
+  VALUE vrecs;                           /* records to be loaded */
+  bool dup;                              /* whether duplicated keys are kept */
+  VALUE vlast;                           /* buffer of the last key */
+  int64_t cnt;                           /* number of stored records */
+  int64_t ucnt;                          /* number of records out of order */
+  bool ok;                               /* whether every record was stored */
+} BULKLOAD;
+
+typedef struct {                         /* type of structure for a fixed-length database object */
+  TCFDB *fdb;                            /* database object */
+  VALUE owner;                           /* owner thread or nil if thread-safe */
+} FDBDATA;
+
+typedef struct {                         /* type of structure for a table database object */
+  TCTDB *tdb;                            /* database object */
+  VALUE owner;                           /* owner thread or nil if thread-safe */
+} TDBDATA;
+
+typedef struct {                         /* type of structure for a query object */
+  TDBQRY *qry;                           /* query object */
+  TDBDATA *tdata;                        /* data of the database object */
+  bool busy;                             /* whether a search is running without the GVL */
+} TDBQRYDATA;
+
+typedef struct {                         /* type of structure for a value view */
+  const char *ptr;                       /* pointer to the region or NULL if expired */
+  int size;                              /* size of the region */
+} VIEWDATA;
+
+typedef struct {                         /* type of structure for a row of a query */
+  TCMAP *cols;                           /* columns of the record or NULL if expired */
+  bool dirty;                            /* whether any column has been written */
+} ROWDATA;
+
+typedef struct {                         /* type of structure for an iteration */
+  void *obj;                             /* database object */
+  int mode;                              /* iteration mode */
+  int num;                               /* number of records in a batch */
+  int kcodec;                            /* key codec */
+  TCXSTR *kxstr;                         /* buffer of the key */
+  TCXSTR *vxstr;                         /* buffer of the value */
+  BDBCUR *cur;                           /* cursor object or NULL */
+  TCLIST *recs;                          /* current chunk of keys and values or NULL */
+  TCXSTR *lxstr;                         /* buffer of the last key of the chunk or NULL */
+  bool view;                             /* whether values are yielded as views */
+  VALUE vview;                           /* view being yielded or nil */
+  bool reverse;                          /* whether to walk backward */
+  int max;                               /* maximum number of records or -1 */
+  char *bkbuf;                           /* lower bound of keys or NULL */
+  int bksiz;                             /* size of the lower bound */
+  bool binc;                             /* whether the lower bound is inclusive */
+  char *ekbuf;                           /* upper bound of keys or NULL */
+  int eksiz;                             /* size of the upper bound */
+  bool einc;                             /* whether the upper bound is inclusive */
+  int64_t lid;                           /* lower bound of ID numbers */
+  int64_t uid;                           /* upper bound of ID numbers */
+  uint64_t *ids;                         /* current chunk of ID numbers or NULL */
+  char *rbuf;                            /* buffer of fixed-length values or NULL */
+  int rsiz;                              /* size of the buffer of values */
+  VALUE vrecs;                           /* current batch of records */
+  VALUE vrv;                             /* value returned by the last call of the block */
+} ITERDATA;
+
+typedef struct {                         /* type of structure for a call without the GVL */
+  void *obj;                             /* database or query object */
+  const char *kbuf;                      /* pointer to the region of the key or the path */
+  int ksiz;                              /* size of the region of the key or the path */
+  const char *vbuf;                      /* pointer to the region of the value or the end key */
+  int vsiz;                              /* size of the region of the value or the end key */
+  int64_t nums[4];                       /* numeric parameters */
+  void *rv;                              /* returned object */
+  int rsiz;                              /* size of the returned region */
+  bool ok;                               /* whether the call succeeded */
+} BLOCKCALL;
+
+typedef struct {                         /* type of structure for a call on a query without the GVL */
+  TDBQRYDATA *data;                      /* data of the query object */
+  void *(*func)(void *);                 /* function called without the GVL */
+  BLOCKCALL *call;                       /* arguments of the call */
+  VALUE vkstr;                           /* string object of the key or nil */
+  VALUE vvstr;                           /* string object of the value or nil */
+} QRYCALL;
+
+typedef struct {                         /* type of structure for a parallel scan */
+  TCHDB *hdb;                            /* database object */
+  pthread_t *threads;                    /* worker threads */
+  int tnum;                              /* number of started workers */
+  int live;                              /* number of running workers */
+  pthread_mutex_t mutex;                 /* mutex for the queue and the flags */
+  pthread_cond_t cond;                   /* condition signaled on every change */
+  TCLIST *queue;                         /* keys and values waiting to be yielded */
+  TCLIST *recs;                          /* keys and values being yielded or NULL */
+  bool stop;                             /* whether the workers should stop */
+  bool intr;                             /* whether the waiting thread was interrupted */
+  bool done;                             /* whether every record has been yielded */
+} PSCAN;
+
+typedef struct {                         /* type of structure for a page of a scan */
+  TCHDB *hdb;                            /* database object */
+  uint64_t iter;                         /* iterator offset to put back */
+  int max;                               /* maximum number of records or -1 */
+  TCXSTR *kxstr;                         /* buffer of the key */
+  TCXSTR *vxstr;                         /* buffer of the value */
+  VALUE vrecs;                           /* records of the page */
+} HSCAN;
+
+typedef struct {                         /* type of structure for a query iteration */
+  TCTDB *tdb;                            /* database object */
+  TCLIST *pkeys;                         /* primary keys of the result or NULL */
+  int mode;                              /* iteration mode */
+  int num;                               /* number of records in a batch */
+  const char *pkbuf;                     /* pointer to the primary key being yielded */
+  int pksiz;                             /* size of the primary key being yielded */
+  TCMAP *cols;                           /* columns being yielded */
+  VALUE vrecs;                           /* current batch of records */
+  VALUE vnames;                          /* names of the columns to fetch or nil */
+  VALUE vrv;                             /* value returned by the last call of the block */
+  VALUE vrow;                            /* row being yielded by `proc' or nil */
+  int flags;                             /* flags returned by the block of `proc' */
+  int state;                             /* tag of the jump out of the block or 0 */
+} QRYITER;
+
+typedef struct {                         /* type of structure for an aggregate state */
+  int64_t cnt;                           /* number of values */
+  double sum;                            /* sum of values */
+  double min;                            /* minimum value */
+  double max;                            /* maximum value */
+} AGGSTATE;
+
+typedef struct {                         /* type of structure for an aggregation */
+  TCTDB *tdb;                            /* database object */
+  const char *name;                      /* name of the aggregated column or NULL */
+  int nsiz;                              /* size of the name */
+  const char *gname;                     /* name of the grouping column or NULL */
+  int gsiz;                              /* size of the grouping name */
+  TCMAP *groups;                         /* states by group or NULL */
+  AGGSTATE total;                        /* state of all records or records without group */
+} AGGDATA;
+
 
 /* private function prototypes */
 static VALUE StringValueEx(VALUE vobj);
+static void StringValueBuf(VALUE vobj, VALBUF *vb);
+static void vkeytobuf(VALUE vkey, int kcodec, VALBUF *vb);
+static VALUE buftovkey(const char *kbuf, int ksiz, int kcodec);
+static VALUE listtovkeys(TCLIST *list, int kcodec);
+static VALUE vhashopt(VALUE vopts, const char *name);
+static VALUE setowner(VALUE vself, VALUE vopts);
+static VALUE vrecstoary(VALUE vrecs, int kcodec);
+static VALUE vkeystoary(VALUE vkeys, int kcodec);
+static int vputmode(VALUE vopts);
+static int vaggfunc(VALUE vfunc);
+static void aggadd(AGGSTATE *state, double num);
+static void aggrec(AGGDATA *agg, TCMAP *cols);
+static VALUE aggvalue(const AGGSTATE *state, int func);
 static TCLIST *varytolist(VALUE vary);
 static VALUE listtovary(TCLIST *list);
 static TCMAP *vhashtomap(VALUE vhash);
 static VALUE maptovhash(TCMAP *map);
+static VALUE maptovkeys(TCMAP *map);
+static VALUE maptovhashcols(TCMAP *map, VALUE vnames);
+static VALUE vcolsopt(VALUE vopts);
+static char *vstrreserve(VALUE vstr, int size, int *sp);
+static void vstrsetlen(VALUE vstr, int size);
+static VALUE vnewenum(VALUE vself, const char *name, int argc, VALUE *argv, bool sized);
+static VALUE enumsize(VALUE vself, VALUE vargs, VALUE veobj);
+static VALUE batchnew(int num);
+static void iterinit(ITERDATA *iter, void *obj, int mode, int num, int kcodec);
+static void iteryield(ITERDATA *iter, const char *kbuf, int ksiz, const char *vbuf, int vsiz);
+static VALUE iterfinish(ITERDATA *iter);
+static VALUE iterfree(VALUE viter);
+static VALUE viewnew(const char *ptr, int size);
+static void viewexpire(VALUE vview);
+static void callblocking(void *(*func)(void *), BLOCKCALL *call, VALUE vkstr, VALUE vvstr);
+static void qrycallblocking(TDBQRYDATA *data, void *(*func)(void *), BLOCKCALL *call,
+                            VALUE vkstr, VALUE vvstr);
+static VALUE qrycallbody(VALUE vqcall);
+static VALUE qrycallend(VALUE vqcall);
+static void *hdbopen_blocking(void *arg);
+static void *hdbget_blocking(void *arg);
+static void *hdbput_blocking(void *arg);
+static void *hdbsync_blocking(void *arg);
+static void *hdboptimize_blocking(void *arg);
+static void *hdbcopy_blocking(void *arg);
+static void *bdbrange_blocking(void *arg);
+static void *tdbqrysearch_blocking(void *arg);
+static void *tdbqrycount_blocking(void *arg);
+static void *tdbqryfetch_blocking(void *arg);
+static void *tdbqryagg_blocking(void *arg);
+static bool pscanstart(PSCAN *scan, TCHDB *hdb, int tnum);
+static void *pscanwork(void *arg);
+static void *pscanwait(void *arg);
+static void pscanintr(void *arg);
+static VALUE pscaniterate(VALUE vscan);
+static VALUE pscanfree(VALUE vscan);
+static VALUE hscanpage(VALUE vscan);
+static VALUE hscanfree(VALUE vscan);
+static int vthreadsopt(VALUE vopts);
 static void hdb_init(void);
-static VALUE hdb_initialize(VALUE vself, SEL sel);
-static VALUE hdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_ecode(VALUE vself, SEL sel);
-static VALUE hdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_open(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_close(VALUE vself, SEL sel);
-static VALUE hdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE hdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE hdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE hdb_putasync(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE hdb_out(VALUE vself, SEL sel, VALUE vkey);
-static VALUE hdb_get(VALUE vself, SEL sel, VALUE vkey);
-static VALUE hdb_vsiz(VALUE vself, SEL sel, VALUE vkey);
-static VALUE hdb_iterinit(VALUE vself, SEL sel);
-static VALUE hdb_iternext(VALUE vself, SEL sel);
-static VALUE hdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE hdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE hdb_sync(VALUE vself, SEL sel);
-static VALUE hdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_vanish(VALUE vself, SEL sel);
-static VALUE hdb_copy(VALUE vself, SEL sel, VALUE vpath);
-static VALUE hdb_tranbegin(VALUE vself, SEL sel);
-static VALUE hdb_trancommit(VALUE vself, SEL sel);
-static VALUE hdb_tranabort(VALUE vself, SEL sel);
-static VALUE hdb_path(VALUE vself, SEL sel);
-static VALUE hdb_rnum(VALUE vself, SEL sel);
-static VALUE hdb_fsiz(VALUE vself, SEL sel);
-static VALUE hdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE hdb_check(VALUE vself, SEL sel, VALUE vkey);
-static VALUE hdb_check_value(VALUE vself, SEL sel, VALUE vval);
-static VALUE hdb_get_reverse(VALUE vself, SEL sel, VALUE vval);
-static VALUE hdb_empty(VALUE vself, SEL sel);
-static VALUE hdb_each(VALUE vself, SEL sel);
-static VALUE hdb_each_key(VALUE vself, SEL sel);
-static VALUE hdb_each_value(VALUE vself, SEL sel);
-static VALUE hdb_keys(VALUE vself, SEL sel);
-static VALUE hdb_values(VALUE vself, SEL sel);
+static void hdb_free(HDBDATA *data);
+static VALUE hdb_alloc(VALUE klass);
+static VALUE hdb_initialize(RBVARARGS);
+static VALUE hdb_errmsg(RBVARARGS);
+static VALUE hdb_ecode(RBSELF);
+static VALUE hdb_tune(RBVARARGS);
+static VALUE hdb_setcache(RBVARARGS);
+static VALUE hdb_setxmsiz(RBVARARGS);
+static VALUE hdb_setdfunit(RBVARARGS);
+static VALUE hdb_open(RBVARARGS);
+static VALUE hdb_close(RBSELF);
+static VALUE hdb_put(RBSELF, VALUE vkey, VALUE vval);
+static VALUE hdb_putkeep(RBSELF, VALUE vkey, VALUE vval);
+static VALUE hdb_putcat(RBSELF, VALUE vkey, VALUE vval);
+static VALUE hdb_putasync(RBSELF, VALUE vkey, VALUE vval);
+static VALUE hdb_put_all(RBVARARGS);
+static VALUE hdb_out(RBSELF, VALUE vkey);
+static VALUE hdb_mout(RBVARARGS);
+static VALUE hdb_get(RBSELF, VALUE vkey);
+static VALUE hdb_mget(RBSELF, VALUE vkeys);
+static VALUE hdb_get_into(RBSELF, VALUE vkey, VALUE vbuf);
+static VALUE hdb_vsiz(RBSELF, VALUE vkey);
+static VALUE hdb_iterinit(RBSELF);
+static VALUE hdb_iternext(RBSELF);
+static VALUE hdb_scan(RBVARARGS);
+static VALUE hdb_fwmkeys(RBVARARGS);
+static VALUE hdb_addint(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE hdb_adddouble(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE hdb_sync(RBSELF);
+static VALUE hdb_optimize(RBVARARGS);
+static VALUE hdb_vanish(RBSELF);
+static VALUE hdb_copy(RBSELF, VALUE vpath);
+static VALUE hdb_tranbegin(RBSELF);
+static VALUE hdb_trancommit(RBSELF);
+static VALUE hdb_tranabort(RBSELF);
+static VALUE hdb_path(RBSELF);
+static VALUE hdb_rnum(RBSELF);
+static VALUE hdb_fsiz(RBSELF);
+static VALUE hdb_fetch(RBVARARGS);
+static VALUE hdb_check(RBSELF, VALUE vkey);
+static VALUE hdb_check_value(RBSELF, VALUE vval);
+static VALUE hdb_get_reverse(RBSELF, VALUE vval);
+static VALUE hdb_empty(RBSELF);
+static VALUE hdb_iterate(VALUE viter);
+static VALUE hdb_each(RBVARARGS);
+static VALUE hdb_each_batch(RBSELF, VALUE vnum);
+static VALUE hdb_parallel_each(RBVARARGS);
+static VALUE hdb_each_key(RBSELF);
+static VALUE hdb_each_value(RBVARARGS);
+static VALUE hdb_keys(RBSELF);
+static VALUE hdb_values(RBSELF);
 static void bdb_init(void);
+static void bdb_free(BDBDATA *data);
+static VALUE bdb_alloc(VALUE klass);
 static int bdb_cmpobj(const char *aptr, int asiz, const char *bptr, int bsiz, VALUE vcmp);
-static VALUE bdb_initialize(VALUE vself, SEL sel);
-static VALUE bdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_ecode(VALUE vself, SEL sel);
-static VALUE bdb_setcmpfunc(VALUE vself, SEL sel, VALUE vcmp);
-static VALUE bdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_open(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_close(VALUE vself, SEL sel);
-static VALUE bdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE bdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE bdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE bdb_putdup(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE bdb_putlist(VALUE vself, SEL sel, VALUE vkey, VALUE vvals);
-static VALUE bdb_out(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_outlist(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_get(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_getlist(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_vnum(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_vsiz(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_range(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE bdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE bdb_sync(VALUE vself, SEL sel);
-static VALUE bdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_vanish(VALUE vself, SEL sel);
-static VALUE bdb_copy(VALUE vself, SEL sel, VALUE vpath);
-static VALUE bdb_tranbegin(VALUE vself, SEL sel);
-static VALUE bdb_trancommit(VALUE vself, SEL sel);
-static VALUE bdb_tranabort(VALUE vself, SEL sel);
-static VALUE bdb_path(VALUE vself, SEL sel);
-static VALUE bdb_rnum(VALUE vself, SEL sel);
-static VALUE bdb_fsiz(VALUE vself, SEL sel);
-static VALUE bdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdb_check(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdb_check_value(VALUE vself, SEL sel, VALUE vval);
-static VALUE bdb_get_reverse(VALUE vself, SEL sel, VALUE vval);
-static VALUE bdb_empty(VALUE vself, SEL sel);
-static VALUE bdb_each(VALUE vself, SEL sel);
-static VALUE bdb_each_key(VALUE vself, SEL sel);
-static VALUE bdb_each_value(VALUE vself, SEL sel);
-static VALUE bdb_keys(VALUE vself, SEL sel);
-static VALUE bdb_values(VALUE vself, SEL sel);
+static VALUE bdb_initialize(RBVARARGS);
+static VALUE bdb_errmsg(RBVARARGS);
+static VALUE bdb_ecode(RBSELF);
+static VALUE bdb_setcmpfunc(RBSELF, VALUE vcmp);
+static VALUE bdb_tune(RBVARARGS);
+static VALUE bdb_setcache(RBVARARGS);
+static VALUE bdb_setxmsiz(RBVARARGS);
+static VALUE bdb_setdfunit(RBVARARGS);
+static VALUE bdb_open(RBVARARGS);
+static VALUE bdb_close(RBSELF);
+static VALUE bdb_put(RBSELF, VALUE vkey, VALUE vval);
+static VALUE bdb_putkeep(RBSELF, VALUE vkey, VALUE vval);
+static VALUE bdb_putcat(RBSELF, VALUE vkey, VALUE vval);
+static VALUE bdb_putdup(RBSELF, VALUE vkey, VALUE vval);
+static VALUE bdb_putlist(RBSELF, VALUE vkey, VALUE vvals);
+static VALUE bdb_put_all(RBVARARGS);
+static bool bdb_bulkloadpair(BULKLOAD *load, VALUE vkey, VALUE vval);
+static VALUE bdb_bulkloadrec(RB_BLOCK_CALL_FUNC_ARGLIST(vrec, vload));
+static VALUE bdb_bulkloadbody(VALUE vload);
+static VALUE bdb_bulk_load(RBVARARGS);
+static VALUE bdb_out(RBSELF, VALUE vkey);
+static VALUE bdb_outlist(RBSELF, VALUE vkey);
+static VALUE bdb_mout(RBVARARGS);
+static VALUE bdb_get(RBSELF, VALUE vkey);
+static VALUE bdb_mget(RBSELF, VALUE vkeys);
+static VALUE bdb_get_into(RBSELF, VALUE vkey, VALUE vbuf);
+static VALUE bdb_getlist(RBSELF, VALUE vkey);
+static VALUE bdb_vnum(RBSELF, VALUE vkey);
+static VALUE bdb_vsiz(RBSELF, VALUE vkey);
+static VALUE bdb_range(RBVARARGS);
+static VALUE bdb_fwmkeys(RBVARARGS);
+static VALUE bdb_addint(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE bdb_adddouble(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE bdb_sync(RBSELF);
+static VALUE bdb_optimize(RBVARARGS);
+static VALUE bdb_vanish(RBSELF);
+static VALUE bdb_copy(RBSELF, VALUE vpath);
+static VALUE bdb_tranbegin(RBSELF);
+static VALUE bdb_trancommit(RBSELF);
+static VALUE bdb_tranabort(RBSELF);
+static VALUE bdb_path(RBSELF);
+static VALUE bdb_rnum(RBSELF);
+static VALUE bdb_fsiz(RBSELF);
+static VALUE bdb_fetch(RBVARARGS);
+static VALUE bdb_check(RBSELF, VALUE vkey);
+static VALUE bdb_check_value(RBSELF, VALUE vval);
+static VALUE bdb_get_reverse(RBSELF, VALUE vval);
+static VALUE bdb_empty(RBSELF);
+static void bdbiterstart(ITERDATA *iter);
+static bool bdbiterinrange(ITERDATA *iter, const char *kbuf, int ksiz);
+static void bdbiterseek(ITERDATA *iter);
+static int bdbiterfill(ITERDATA *iter, int max);
+static VALUE bdb_iterate(VALUE viter);
+static VALUE bdbrangeback(BDBDATA *data, VALBUF *bkey, bool binc, VALBUF *ekey, bool einc, int max);
+static VALUE bdb_each(RBVARARGS);
+static VALUE bdb_each_batch(RBSELF, VALUE vnum);
+static VALUE bdb_each_range(RBVARARGS);
+static VALUE bdb_each_reverse(RBVARARGS);
+static VALUE bdb_each_key(RBSELF);
+static VALUE bdb_each_value(RBVARARGS);
+static VALUE bdb_keys(RBSELF);
+static VALUE bdb_values(RBSELF);
+static VALUE bdb_kcodec(RBSELF);
+static VALUE bdb_setkcodec(RBSELF, VALUE vcodec);
 static void bdbcur_init(void);
-static VALUE bdbcur_initialize(VALUE vself, SEL sel, VALUE vbdb);
-static VALUE bdbcur_first(VALUE vself, SEL sel);
-static VALUE bdbcur_last(VALUE vself, SEL sel);
-static VALUE bdbcur_jump(VALUE vself, SEL sel, VALUE vkey);
-static VALUE bdbcur_prev(VALUE vself, SEL sel);
-static VALUE bdbcur_next(VALUE vself, SEL sel);
-static VALUE bdbcur_put(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE bdbcur_out(VALUE vself, SEL sel);
-static VALUE bdbcur_key(VALUE vself, SEL sel);
-static VALUE bdbcur_val(VALUE vself, SEL sel);
+static void bdbcur_free(BDBCURDATA *data);
+static VALUE bdbcur_alloc(VALUE klass);
+static VALUE bdbcur_initialize(RBSELF, VALUE vbdb);
+static VALUE bdbcur_first(RBSELF);
+static VALUE bdbcur_last(RBSELF);
+static VALUE bdbcur_jump(RBSELF, VALUE vkey);
+static VALUE bdbcur_prev(RBSELF);
+static VALUE bdbcur_next(RBSELF);
+static VALUE bdbcur_put(RBVARARGS);
+static VALUE bdbcur_out(RBSELF);
+static VALUE bdbcur_key(RBSELF);
+static VALUE bdbcur_val(RBSELF);
+static VALUE bdbcur_next_n(RBSELF, VALUE vnum);
+static VALUE bdbcur_prev_n(RBSELF, VALUE vnum);
+static VALUE bdbcurrecs(VALUE vself, VALUE vnum, bool back);
+static VALUE bdbcurfill(VALUE viter);
 static void fdb_init(void);
-static VALUE fdb_initialize(VALUE vself, SEL sel);
-static VALUE fdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_ecode(VALUE vself, SEL sel);
-static VALUE fdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_open(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_close(VALUE vself, SEL sel);
-static VALUE fdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE fdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE fdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE fdb_out(VALUE vself, SEL sel, VALUE vkey);
-static VALUE fdb_get(VALUE vself, SEL sel, VALUE vkey);
-static VALUE fdb_vsiz(VALUE vself, SEL sel, VALUE vkey);
-static VALUE fdb_iterinit(VALUE vself, SEL sel);
-static VALUE fdb_iternext(VALUE vself, SEL sel);
-static VALUE fdb_range(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE fdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE fdb_sync(VALUE vself, SEL sel);
-static VALUE fdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_vanish(VALUE vself, SEL sel);
-static VALUE fdb_copy(VALUE vself, SEL sel, VALUE vpath);
-static VALUE fdb_tranbegin(VALUE vself, SEL sel);
-static VALUE fdb_trancommit(VALUE vself, SEL sel);
-static VALUE fdb_tranabort(VALUE vself, SEL sel);
-static VALUE fdb_path(VALUE vself, SEL sel);
-static VALUE fdb_rnum(VALUE vself, SEL sel);
-static VALUE fdb_fsiz(VALUE vself, SEL sel);
-static VALUE fdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE fdb_check(VALUE vself, SEL sel, VALUE vkey);
-static VALUE fdb_check_value(VALUE vself, SEL sel, VALUE vval);
-static VALUE fdb_get_reverse(VALUE vself, SEL sel, VALUE vval);
-static VALUE fdb_empty(VALUE vself, SEL sel);
-static VALUE fdb_each(VALUE vself, SEL sel);
-static VALUE fdb_each_key(VALUE vself, SEL sel);
-static VALUE fdb_each_value(VALUE vself, SEL sel);
-static VALUE fdb_keys(VALUE vself, SEL sel);
-static VALUE fdb_values(VALUE vself, SEL sel);
+static void fdb_free(FDBDATA *data);
+static VALUE fdb_alloc(VALUE klass);
+static VALUE fdb_initialize(RBVARARGS);
+static VALUE fdb_errmsg(RBVARARGS);
+static VALUE fdb_ecode(RBSELF);
+static VALUE fdb_tune(RBVARARGS);
+static VALUE fdb_open(RBVARARGS);
+static VALUE fdb_close(RBSELF);
+static VALUE fdb_put(RBSELF, VALUE vkey, VALUE vval);
+static VALUE fdb_putkeep(RBSELF, VALUE vkey, VALUE vval);
+static VALUE fdb_putcat(RBSELF, VALUE vkey, VALUE vval);
+static VALUE fdb_put_all(RBVARARGS);
+static VALUE fdb_out(RBSELF, VALUE vkey);
+static VALUE fdb_mout(RBVARARGS);
+static VALUE fdb_get(RBSELF, VALUE vkey);
+static VALUE fdb_mget(RBSELF, VALUE vkeys);
+static VALUE fdb_get_into(RBSELF, VALUE vkey, VALUE vbuf);
+static VALUE fdb_get_id(RBSELF, VALUE vid);
+static VALUE fdb_vsiz(RBSELF, VALUE vkey);
+static VALUE fdb_iterinit(RBSELF);
+static VALUE fdb_iternext(RBSELF);
+static VALUE fdb_iternext_id(RBSELF);
+static VALUE fdb_range(RBVARARGS);
+static VALUE fdb_range_ids(RBVARARGS);
+static VALUE fdb_addint(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE fdb_adddouble(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE fdb_sync(RBSELF);
+static VALUE fdb_optimize(RBVARARGS);
+static VALUE fdb_vanish(RBSELF);
+static VALUE fdb_copy(RBSELF, VALUE vpath);
+static VALUE fdb_tranbegin(RBSELF);
+static VALUE fdb_trancommit(RBSELF);
+static VALUE fdb_tranabort(RBSELF);
+static VALUE fdb_path(RBSELF);
+static VALUE fdb_rnum(RBSELF);
+static VALUE fdb_fsiz(RBSELF);
+static VALUE fdb_fetch(RBVARARGS);
+static VALUE fdb_check(RBSELF, VALUE vkey);
+static VALUE fdb_check_value(RBSELF, VALUE vval);
+static VALUE fdb_get_reverse(RBSELF, VALUE vval);
+static VALUE fdb_empty(RBSELF);
+static VALUE fdb_each(RBSELF);
+static VALUE fdb_each_batch(RBSELF, VALUE vnum);
+static VALUE fdb_iterate(VALUE viter);
+static VALUE fdb_each_id(RBSELF);
+static VALUE fdb_each_id_range(RBVARARGS);
+static VALUE fdbeachids(VALUE vself, const char *name, int argc, VALUE *argv, VALUE vlower, VALUE vupper);
+static VALUE fdb_each_key(RBSELF);
+static VALUE fdb_each_value(RBSELF);
+static VALUE fdb_keys(RBSELF);
+static VALUE fdb_values(RBSELF);
 static void tdb_init(void);
-static VALUE tdb_initialize(VALUE vself, SEL sel);
-static VALUE tdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_ecode(VALUE vself, SEL sel);
-static VALUE tdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_open(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_close(VALUE vself, SEL sel);
-static VALUE tdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vcols);
-static VALUE tdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vcols);
-static VALUE tdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vcols);
-static VALUE tdb_out(VALUE vself, SEL sel, VALUE vkey);
-static VALUE tdb_get(VALUE vself, SEL sel, VALUE vkey);
-static VALUE tdb_vsiz(VALUE vself, SEL sel, VALUE vkey);
-static VALUE tdb_iterinit(VALUE vself, SEL sel);
-static VALUE tdb_iternext(VALUE vself, SEL sel);
-static VALUE tdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE tdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE tdb_sync(VALUE vself, SEL sel);
-static VALUE tdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_vanish(VALUE vself, SEL sel);
-static VALUE tdb_copy(VALUE vself, SEL sel, VALUE vpath);
-static VALUE tdb_tranbegin(VALUE vself, SEL sel);
-static VALUE tdb_trancommit(VALUE vself, SEL sel);
-static VALUE tdb_tranabort(VALUE vself, SEL sel);
-static VALUE tdb_path(VALUE vself, SEL sel);
-static VALUE tdb_rnum(VALUE vself, SEL sel);
-static VALUE tdb_fsiz(VALUE vself, SEL sel);
-static VALUE tdb_setindex(VALUE vself, SEL sel, VALUE vname, VALUE vtype);
-static VALUE tdb_genuid(VALUE vself, SEL sel);
-static VALUE tdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdb_check(VALUE vself, SEL sel, VALUE vkey);
-static VALUE tdb_empty(VALUE vself, SEL sel);
-static VALUE tdb_each(VALUE vself, SEL sel);
-static VALUE tdb_each_key(VALUE vself, SEL sel);
-static VALUE tdb_each_value(VALUE vself, SEL sel);
-static VALUE tdb_keys(VALUE vself, SEL sel);
-static VALUE tdb_values(VALUE vself, SEL sel);
+static void tdb_free(TDBDATA *data);
+static VALUE tdb_alloc(VALUE klass);
+static VALUE tdb_initialize(RBVARARGS);
+static VALUE tdb_errmsg(RBVARARGS);
+static VALUE tdb_ecode(RBSELF);
+static VALUE tdb_tune(RBVARARGS);
+static VALUE tdb_setcache(RBVARARGS);
+static VALUE tdb_setxmsiz(RBVARARGS);
+static VALUE tdb_setdfunit(RBVARARGS);
+static VALUE tdb_open(RBVARARGS);
+static VALUE tdb_close(RBSELF);
+static VALUE tdb_put(RBSELF, VALUE vkey, VALUE vcols);
+static VALUE tdb_putkeep(RBSELF, VALUE vkey, VALUE vcols);
+static VALUE tdb_putcat(RBSELF, VALUE vkey, VALUE vcols);
+static VALUE tdb_out(RBSELF, VALUE vkey);
+static VALUE tdb_mout(RBVARARGS);
+static VALUE tdb_get(RBVARARGS);
+static VALUE tdb_mget(RBVARARGS);
+static VALUE tdb_vsiz(RBSELF, VALUE vkey);
+static VALUE tdb_iterinit(RBSELF);
+static VALUE tdb_iternext(RBSELF);
+static VALUE tdb_fwmkeys(RBVARARGS);
+static VALUE tdb_addint(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE tdb_adddouble(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE tdb_sync(RBSELF);
+static VALUE tdb_optimize(RBVARARGS);
+static VALUE tdb_vanish(RBSELF);
+static VALUE tdb_copy(RBSELF, VALUE vpath);
+static VALUE tdb_tranbegin(RBSELF);
+static VALUE tdb_trancommit(RBSELF);
+static VALUE tdb_tranabort(RBSELF);
+static VALUE tdb_path(RBSELF);
+static VALUE tdb_rnum(RBSELF);
+static VALUE tdb_fsiz(RBSELF);
+static VALUE tdb_setindex(RBSELF, VALUE vname, VALUE vtype);
+static VALUE tdb_genuid(RBSELF);
+static VALUE tdb_fetch(RBVARARGS);
+static VALUE tdb_check(RBSELF, VALUE vkey);
+static VALUE tdb_empty(RBSELF);
+static VALUE tdbiternext(TCTDB *tdb, VALUE *vpkey, VALUE vnames);
+static VALUE tdb_each(RBVARARGS);
+static VALUE tdb_each_batch(RBSELF, VALUE vnum);
+static VALUE tdb_each_key(RBSELF);
+static VALUE tdb_each_value(RBSELF);
+static VALUE tdb_keys(RBSELF);
+static VALUE tdb_values(RBSELF);
 static void tdbqry_init(void);
+static void tdbqry_free(TDBQRYDATA *data);
+static VALUE tdbqry_alloc(VALUE klass);
 static int tdbqry_procrec(const void *pkbuf, int pksiz, TCMAP *cols, void *opq);
-static VALUE tdbqry_initialize(VALUE vself, SEL sel, VALUE vtdb);
-static VALUE tdbqry_addcond(VALUE vself, SEL sel, VALUE vname, VALUE vop, VALUE vexpr);
-static VALUE tdbqry_setorder(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdbqry_setlimit(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdbqry_search(VALUE vself, SEL sel);
-static VALUE tdbqry_searchout(VALUE vself, SEL sel);
-static VALUE tdbqry_proc(VALUE vself, SEL sel, VALUE vproc);
-static VALUE tdbqry_hint(VALUE vself, SEL sel);
-static VALUE tdbqry_metasearch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE tdbqry_kwic(VALUE vself, SEL sel, int argc, VALUE *argv);
+static VALUE tdbqry_procyield(VALUE viter);
+static VALUE tdbqry_eachyield(VALUE viter);
+static VALUE tdbqry_eachfree(VALUE viter);
+static VALUE tdbqry_rowsfill(VALUE viter);
+static VALUE tdbqryiterate(VALUE vself, int mode, int num);
+static VALUE tdbqryfetch(TCTDB *tdb, TCLIST *pkeys, int start, int num, VALUE vnames);
+static VALUE tdbqry_initialize(RBSELF, VALUE vtdb);
+static VALUE tdbqry_addcond(RBSELF, VALUE vname, VALUE vop, VALUE vexpr);
+static VALUE tdbqry_setorder(RBVARARGS);
+static VALUE tdbqry_setlimit(RBVARARGS);
+static VALUE tdbqry_search(RBSELF);
+static VALUE tdbqry_count(RBSELF);
+static VALUE tdbqry_search_rows(RBVARARGS);
+static VALUE tdbqry_searchout(RBSELF);
+static VALUE tdbqry_proc(RBSELF);
+static VALUE tdbqry_each(RBSELF);
+static VALUE tdbqry_each_batch(RBSELF, VALUE vnum);
+static VALUE tdbqry_aggregate(RBVARARGS);
+static VALUE tdbqry_hint(RBSELF);
+static VALUE tdbqry_metasearch(RBVARARGS);
+static VALUE tdbqry_kwic(RBVARARGS);
 static void adb_init(void);
-static VALUE adb_initialize(VALUE vself, SEL sel);
-static VALUE adb_open(VALUE vself, SEL sel, VALUE vname);
-static VALUE adb_close(VALUE vself, SEL sel);
-static VALUE adb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE adb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE adb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval);
-static VALUE adb_out(VALUE vself, SEL sel, VALUE vkey);
-static VALUE adb_get(VALUE vself, SEL sel, VALUE vkey);
-static VALUE adb_vsiz(VALUE vself, SEL sel, VALUE vkey);
-static VALUE adb_iterinit(VALUE vself, SEL sel);
-static VALUE adb_iternext(VALUE vself, SEL sel);
-static VALUE adb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE adb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE adb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum);
-static VALUE adb_sync(VALUE vself, SEL sel);
-static VALUE adb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE adb_vanish(VALUE vself, SEL sel);
-static VALUE adb_copy(VALUE vself, SEL sel, VALUE vpath);
-static VALUE adb_tranbegin(VALUE vself, SEL sel);
-static VALUE adb_trancommit(VALUE vself, SEL sel);
-static VALUE adb_tranabort(VALUE vself, SEL sel);
-static VALUE adb_path(VALUE vself, SEL sel);
-static VALUE adb_rnum(VALUE vself, SEL sel);
-static VALUE adb_size(VALUE vself, SEL sel);
-static VALUE adb_misc(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE adb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv);
-static VALUE adb_check(VALUE vself, SEL sel, VALUE vkey);
-static VALUE adb_check_value(VALUE vself, SEL sel, VALUE vval);
-static VALUE adb_get_reverse(VALUE vself, SEL sel, VALUE vval);
-static VALUE adb_empty(VALUE vself, SEL sel);
-static VALUE adb_each(VALUE vself, SEL sel);
-static VALUE adb_each_key(VALUE vself, SEL sel);
-static VALUE adb_each_value(VALUE vself, SEL sel);
-static VALUE adb_keys(VALUE vself, SEL sel);
-static VALUE adb_values(VALUE vself, SEL sel);
+static VALUE adb_alloc(VALUE klass);
+static VALUE adb_initialize(RBSELF);
+static VALUE adb_open(RBSELF, VALUE vname);
+static VALUE adb_close(RBSELF);
+static VALUE adb_put(RBSELF, VALUE vkey, VALUE vval);
+static VALUE adb_putkeep(RBSELF, VALUE vkey, VALUE vval);
+static VALUE adb_putcat(RBSELF, VALUE vkey, VALUE vval);
+static VALUE adb_put_all(RBVARARGS);
+static VALUE adb_out(RBSELF, VALUE vkey);
+static VALUE adb_mout(RBVARARGS);
+static VALUE adb_get(RBSELF, VALUE vkey);
+static VALUE adb_mget(RBSELF, VALUE vkeys);
+static VALUE adb_get_into(RBSELF, VALUE vkey, VALUE vbuf);
+static VALUE adb_vsiz(RBSELF, VALUE vkey);
+static VALUE adb_iterinit(RBSELF);
+static VALUE adb_iternext(RBSELF);
+static VALUE adb_fwmkeys(RBVARARGS);
+static VALUE adb_addint(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE adb_adddouble(RBSELF, VALUE vkey, VALUE vnum);
+static VALUE adb_sync(RBSELF);
+static VALUE adb_optimize(RBVARARGS);
+static VALUE adb_vanish(RBSELF);
+static VALUE adb_copy(RBSELF, VALUE vpath);
+static VALUE adb_tranbegin(RBSELF);
+static VALUE adb_trancommit(RBSELF);
+static VALUE adb_tranabort(RBSELF);
+static VALUE adb_path(RBSELF);
+static VALUE adb_rnum(RBSELF);
+static VALUE adb_size(RBSELF);
+static VALUE adb_misc(RBVARARGS);
+static VALUE adb_fetch(RBVARARGS);
+static VALUE adb_check(RBSELF, VALUE vkey);
+static VALUE adb_check_value(RBSELF, VALUE vval);
+static VALUE adb_get_reverse(RBSELF, VALUE vval);
+static VALUE adb_empty(RBSELF);
+static VALUE adbiterate(TCADB *adb);
+static VALUE adb_each(RBSELF);
+static VALUE adb_parallel_each(RBVARARGS);
+static VALUE adb_each_batch(RBSELF, VALUE vnum);
+static VALUE adb_each_key(RBSELF);
+static VALUE adb_each_value(RBSELF);
+static VALUE adb_keys(RBSELF);
+static VALUE adb_values(RBSELF);
+static void view_init(void);
+static VALUE view_size(RBSELF);
+static VALUE view_to_s(RBSELF);
+static VALUE view_getbyte(RBSELF, VALUE vidx);
+static VALUE view_byteslice(RBVARARGS);
+static VALUE view_start_with(RBSELF, VALUE vstr);
+static VALUE view_equal(RBSELF, VALUE vobj);
+static VALUE view_valid(RBSELF);
+static VALUE view_inspect(RBSELF);
+static VALUE rownew(TCMAP *cols);
+static bool rowexpire(VALUE vrow);
+static VALUE roweach(VALUE vself, const char *name, int mode);
+static void row_init(void);
+static VALUE row_get(RBSELF, VALUE vname);
+static VALUE row_fetch(RBVARARGS);
+static VALUE row_put(RBSELF, VALUE vname, VALUE vval);
+static VALUE row_delete(RBSELF, VALUE vname);
+static VALUE row_merge(RBSELF, VALUE vhash);
+static VALUE row_clear(RBSELF);
+static VALUE row_has_key(RBSELF, VALUE vname);
+static VALUE row_keys(RBSELF);
+static VALUE row_values(RBSELF);
+static VALUE row_size(RBSELF);
+static VALUE row_empty(RBSELF);
+static VALUE row_each(RBSELF);
+static VALUE row_each_key(RBSELF);
+static VALUE row_each_value(RBSELF);
+static VALUE row_select(RBSELF);
+static VALUE row_reject(RBSELF);
+static VALUE row_to_hash(RBSELF);
+static VALUE row_valid(RBSELF);
+
+static const DATATYPE hdb_type = { "TokyoCabinet::HDB", { 0, (RUBY_DATA_FUNC)hdb_free } };
+static const DATATYPE bdb_type = { "TokyoCabinet::BDB", { 0, (RUBY_DATA_FUNC)bdb_free } };
+static const DATATYPE bdbcur_type = { "TokyoCabinet::BDBCUR", { 0, (RUBY_DATA_FUNC)bdbcur_free } };
+static const DATATYPE fdb_type = { "TokyoCabinet::FDB", { 0, (RUBY_DATA_FUNC)fdb_free } };
+static const DATATYPE tdb_type = { "TokyoCabinet::TDB", { 0, (RUBY_DATA_FUNC)tdb_free } };
+static const DATATYPE tdbqry_type = { "TokyoCabinet::TDBQRY", { 0, (RUBY_DATA_FUNC)tdbqry_free } };
+static const DATATYPE adb_type = { "TokyoCabinet::ADB", { 0, (RUBY_DATA_FUNC)tcadbdel } };
+static const DATATYPE view_type = { "TokyoCabinet::View", { 0, (RUBY_DATA_FUNC)tcfree } };
+static const DATATYPE row_type = { "TokyoCabinet::TDBQRY::Row", { 0, (RUBY_DATA_FUNC)tcfree } };
 
 
 
@@ -290,20 +781,15 @@ static VALUE adb_values(VALUE vself, SEL sel);
 
 VALUE mod_tokyocabinet;
 VALUE cls_hdb;
-VALUE cls_hdb_data;
 VALUE cls_bdb;
-VALUE cls_bdb_data;
 VALUE cls_bdbcur;
-VALUE cls_bdbcur_data;
 ID bdb_cmp_call_mid;
 VALUE cls_fdb;
-VALUE cls_fdb_data;
 VALUE cls_tdb;
-VALUE cls_tdb_data;
 VALUE cls_tdbqry;
-VALUE cls_tdbqry_data;
 VALUE cls_adb;
-VALUE cls_adb_data;
+VALUE cls_view;
+VALUE cls_row;
 
 
 int Init_tokyocabinet(void){
@@ -316,6 +802,8 @@ int Init_tokyocabinet(void){
   tdb_init();
   tdbqry_init();
   adb_init();
+  view_init();
+  row_init();
   return 0;
 }
 
@@ -331,7 +819,7 @@ static VALUE StringValueEx(VALUE vobj){
   int ksiz;
   switch(TYPE(vobj)){
   case T_FIXNUM:
-    ksiz = sprintf(kbuf, "%d", (int)FIX2INT(vobj));
+    ksiz = sprintf(kbuf, "%ld", (long)FIX2LONG(vobj));
     return rb_str_new(kbuf, ksiz);
   case T_BIGNUM:
     ksiz = sprintf(kbuf, "%lld", (long long)NUM2LL(vobj));
@@ -350,16 +838,81 @@ static VALUE StringValueEx(VALUE vobj){
 }
 
 
+static void StringValueBuf(VALUE vobj, VALBUF *vb){
+  switch(TYPE(vobj)){
+  case T_FIXNUM:
+    vb->size = sprintf(vb->buf, "%ld", (long)FIX2LONG(vobj));
+    break;
+  case T_BIGNUM:
+    vb->size = sprintf(vb->buf, "%lld", (long long)NUM2LL(vobj));
+    break;
+  case T_TRUE:
+    vb->size = sprintf(vb->buf, "true");
+    break;
+  case T_FALSE:
+    vb->size = sprintf(vb->buf, "false");
+    break;
+  case T_NIL:
+    vb->size = sprintf(vb->buf, "nil");
+    break;
+  default:
+    vb->vstr = StringValue(vobj);
+    vb->ptr = RSTRING_PTR(vb->vstr);
+    vb->size = RSTRING_LEN(vb->vstr);
+    return;
+  }
+  vb->vstr = Qnil;
+  vb->ptr = vb->buf;
+}
+
+
+static void vkeytobuf(VALUE vkey, int kcodec, VALBUF *vb){
+  int32_t inum;
+  int64_t lnum;
+  if(kcodec == KCSTRING || (TYPE(vkey) != T_FIXNUM && TYPE(vkey) != T_BIGNUM)){
+    StringValueBuf(vkey, vb);
+    return;
+  }
+  if(kcodec == KCINT32){
+    inum = NUM2INT(vkey);
+    memcpy(vb->buf, &inum, sizeof(inum));
+    vb->size = sizeof(inum);
+  } else {
+    lnum = NUM2LL(vkey);
+    memcpy(vb->buf, &lnum, sizeof(lnum));
+    vb->size = sizeof(lnum);
+  }
+  vb->vstr = Qnil;
+  vb->ptr = vb->buf;
+}
+
+
+static VALUE buftovkey(const char *kbuf, int ksiz, int kcodec){
+  int32_t inum;
+  int64_t lnum;
+  if(kcodec == KCINT32 && ksiz == sizeof(inum)){
+    memcpy(&inum, kbuf, sizeof(inum));
+    return INT2NUM(inum);
+  }
+  if(kcodec == KCINT64 && ksiz == sizeof(lnum)){
+    memcpy(&lnum, kbuf, sizeof(lnum));
+    return LL2NUM(lnum);
+  }
+  return rb_str_new(kbuf, ksiz);
+}
+
+
 static TCLIST *varytolist(VALUE vary){
   VALUE vval;
   TCLIST *list;
+  VALBUF val;
   int i, num;
   num = RARRAY_LEN(vary);
   list = tclistnew2(num);
   for(i = 0; i < num; i++){
     vval = rb_ary_entry(vary, i);
-    vval = StringValueEx(vval);
-    tclistpush(list, RSTRING_PTR(vval), RSTRING_LEN(vval));
+    StringValueBuf(vval, &val);
+    tclistpush(list, val.ptr, val.size);
   }
   return list;
 }
@@ -379,9 +932,149 @@ static VALUE listtovary(TCLIST *list){
 }
 
 
+static VALUE listtovkeys(TCLIST *list, int kcodec){
+  VALUE vary;
+  const char *kbuf;
+  int i, num, ksiz;
+  num = tclistnum(list);
+  vary = rb_ary_new2(num);
+  for(i = 0; i < num; i++){
+    kbuf = tclistval(list, i, &ksiz);
+    rb_ary_push(vary, buftovkey(kbuf, ksiz, kcodec));
+  }
+  return vary;
+}
+
+
+static VALUE vhashopt(VALUE vopts, const char *name){
+  if(vopts == Qnil) return Qnil;
+  Check_Type(vopts, T_HASH);
+  return rb_hash_aref(vopts, ID2SYM(rb_intern(name)));
+}
+
+
+static VALUE setowner(VALUE vself, VALUE vopts){
+  VALUE vowner;
+  vowner = (vhashopt(vopts, "threadsafe") == Qfalse) ? rb_thread_current() : Qnil;
+  rb_iv_set(vself, OWNERVNDATA, vowner);
+  return vowner;
+}
+
+
+static VALUE vrecstoary(VALUE vrecs, int kcodec){
+  VALUE vary, vrec, vkey, vval;
+  VALBUF key, val;
+  int i, num;
+  if(TYPE(vrecs) == T_HASH) vrecs = rb_funcall(vrecs, rb_intern("to_a"), 0);
+  Check_Type(vrecs, T_ARRAY);
+  num = RARRAY_LEN(vrecs);
+  vary = rb_ary_new2(num * 2);
+  for(i = 0; i < num; i++){
+    vrec = rb_ary_entry(vrecs, i);
+    Check_Type(vrec, T_ARRAY);
+    if(RARRAY_LEN(vrec) != 2) rb_raise(rb_eArgError, "wrong record size (expected a pair)");
+    vkey = rb_ary_entry(vrec, 0);
+    vval = rb_ary_entry(vrec, 1);
+    vkeytobuf(vkey, kcodec, &key);
+    StringValueBuf(vval, &val);
+    rb_ary_push(vary, (key.vstr != Qnil) ? key.vstr : vkey);
+    rb_ary_push(vary, (val.vstr != Qnil) ? val.vstr : vval);
+  }
+  return vary;
+}
+
+
+static VALUE vkeystoary(VALUE vkeys, int kcodec){
+  VALUE vary, vkey;
+  VALBUF key;
+  int i, num;
+  Check_Type(vkeys, T_ARRAY);
+  num = RARRAY_LEN(vkeys);
+  vary = rb_ary_new2(num);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    vkeytobuf(vkey, kcodec, &key);
+    rb_ary_push(vary, (key.vstr != Qnil) ? key.vstr : vkey);
+  }
+  return vary;
+}
+
+
+static int vputmode(VALUE vopts){
+  VALUE vmode;
+  vmode = vhashopt(vopts, "mode");
+  if(vmode == Qnil || vmode == ID2SYM(rb_intern("put"))) return PMPUT;
+  if(vmode == ID2SYM(rb_intern("keep"))) return PMKEEP;
+  if(vmode == ID2SYM(rb_intern("cat"))) return PMCAT;
+  rb_raise(rb_eArgError, "unknown put mode");
+  return PMPUT;
+}
+
+
+static int vaggfunc(VALUE vfunc){
+  if(vfunc == ID2SYM(rb_intern("count"))) return AFCOUNT;
+  if(vfunc == ID2SYM(rb_intern("sum"))) return AFSUM;
+  if(vfunc == ID2SYM(rb_intern("min"))) return AFMIN;
+  if(vfunc == ID2SYM(rb_intern("max"))) return AFMAX;
+  if(vfunc == ID2SYM(rb_intern("avg"))) return AFAVG;
+  rb_raise(rb_eArgError, "unknown aggregate function");
+  return AFCOUNT;
+}
+
+
+static void aggadd(AGGSTATE *state, double num){
+  if(state->cnt < 1){
+    state->min = num;
+    state->max = num;
+  } else {
+    if(num < state->min) state->min = num;
+    if(num > state->max) state->max = num;
+  }
+  state->sum += num;
+  state->cnt++;
+}
+
+
+static void aggrec(AGGDATA *agg, TCMAP *cols){
+  AGGSTATE state;
+  const char *vbuf, *gbuf;
+  const void *sbuf;
+  int vsiz, gsiz, ssiz;
+  double num;
+  num = 0.0;
+  if(agg->name){
+    if(!(vbuf = tcmapget(cols, agg->name, agg->nsiz, &vsiz))) return;
+    num = tcatof(vbuf);
+  }
+  if(agg->groups && (gbuf = tcmapget(cols, agg->gname, agg->gsiz, &gsiz)) != NULL){
+    if((sbuf = tcmapget(agg->groups, gbuf, gsiz, &ssiz)) != NULL && ssiz == sizeof(state)){
+      memcpy(&state, sbuf, sizeof(state));
+    } else {
+      memset(&state, 0, sizeof(state));
+    }
+    aggadd(&state, num);
+    tcmapput(agg->groups, gbuf, gsiz, &state, sizeof(state));
+  } else {
+    aggadd(&agg->total, num);
+  }
+}
+
+
+static VALUE aggvalue(const AGGSTATE *state, int func){
+  switch(func){
+  case AFCOUNT: return LL2NUM(state->cnt);
+  case AFSUM: return rb_float_new(state->sum);
+  case AFMIN: return state->cnt > 0 ? rb_float_new(state->min) : Qnil;
+  case AFMAX: return state->cnt > 0 ? rb_float_new(state->max) : Qnil;
+  }
+  return state->cnt > 0 ? rb_float_new(state->sum / state->cnt) : Qnil;
+}
+
+
 static TCMAP *vhashtomap(VALUE vhash){
   VALUE vkeys, vkey, vval;
   TCMAP *map;
+  VALBUF key, val;
   int i, num;
   map = tcmapnew2(31);
   vkeys = rb_funcall(vhash, rb_intern("keys"), 0);
@@ -389,9 +1082,9 @@ static TCMAP *vhashtomap(VALUE vhash){
   for(i = 0; i < num; i++){
     vkey = rb_ary_entry(vkeys, i);
     vval = rb_hash_aref(vhash, vkey);
-    vkey = StringValueEx(vkey);
-    vval = StringValueEx(vval);
-    tcmapput(map, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval), RSTRING_LEN(vval));
+    StringValueBuf(vkey, &key);
+    StringValueBuf(vval, &val);
+    tcmapput(map, key.ptr, key.size, val.ptr, val.size);
   }
   return map;
 }
@@ -411,9 +1104,557 @@ static VALUE maptovhash(TCMAP *map){
 }
 
 
+static VALUE maptovkeys(TCMAP *map){
+  const char *kbuf;
+  int ksiz;
+  VALUE vary;
+  vary = rb_ary_new2(tcmaprnum(map));
+  tcmapiterinit(map);
+  while((kbuf = tcmapiternext(map, &ksiz)) != NULL){
+    rb_ary_push(vary, rb_str_new(kbuf, ksiz));
+  }
+  return vary;
+}
+
+
+static VALUE maptovhashcols(TCMAP *map, VALUE vnames){
+  VALUE vhash, vname;
+  const char *vbuf;
+  int i, num, vsiz;
+  if(vnames == Qnil) return maptovhash(map);
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vnames);
+  for(i = 0; i < num; i++){
+    vname = rb_ary_entry(vnames, i);
+    if((vbuf = tcmapget(map, RSTRING_PTR(vname), RSTRING_LEN(vname), &vsiz)) != NULL)
+      rb_hash_aset(vhash, vname, rb_str_new(vbuf, vsiz));
+  }
+  return vhash;
+}
+
+
+static VALUE vcolsopt(VALUE vopts){
+  VALUE vnames, vary;
+  int i, num;
+  vnames = vhashopt(vopts, "columns");
+  if(vnames == Qnil) return Qnil;
+  Check_Type(vnames, T_ARRAY);
+  num = RARRAY_LEN(vnames);
+  vary = rb_ary_new2(num);
+  for(i = 0; i < num; i++){
+    rb_ary_push(vary, rb_str_new4(StringValueEx(rb_ary_entry(vnames, i))));
+  }
+  return vary;
+}
+
+
+static char *vstrreserve(VALUE vstr, int size, int *sp){
+  Check_Type(vstr, T_STRING);
+  rb_str_modify(vstr);
+#if defined(HAVE_RB_STR_MODIFY_EXPAND)
+  if((int)rb_str_capacity(vstr) < size) rb_str_modify_expand(vstr, size - RSTRING_LEN(vstr));
+  *sp = rb_str_capacity(vstr);
+#else
+  if(RSTRING_LEN(vstr) < size) rb_str_resize(vstr, size);
+  *sp = RSTRING_LEN(vstr);
+#endif
+  return RSTRING_PTR(vstr);
+}
+
+
+static void vstrsetlen(VALUE vstr, int size){
+#if defined(HAVE_RB_STR_MODIFY_EXPAND)
+  rb_str_set_len(vstr, size);
+#else
+  rb_str_resize(vstr, size);
+#endif
+}
+
+
+static VALUE vnewenum(VALUE vself, const char *name, int argc, VALUE *argv, bool sized){
+#if defined(RETURN_SIZED_ENUMERATOR)
+  return rb_enumeratorize_with_size(vself, ID2SYM(rb_intern(name)), argc, argv,
+                                    sized ? enumsize : 0);
+#else
+  VALUE *vargs;
+  vargs = ALLOCA_N(VALUE, argc + 1);
+  vargs[0] = ID2SYM(rb_intern(name));
+  if(argc > 0) MEMCPY(vargs + 1, argv, VALUE, argc);
+  return rb_funcall2(vself, rb_intern("to_enum"), argc + 1, vargs);
+#endif
+}
+
+
+static VALUE enumsize(VALUE vself, VALUE vargs, VALUE veobj){
+  return rb_funcall(vself, rb_intern("rnum"), 0);
+}
+
+
+static VALUE batchnew(int num){
+  return rb_ary_new2(num < BATCHUNIT ? num : BATCHUNIT);
+}
+
+
+static void iterinit(ITERDATA *iter, void *obj, int mode, int num, int kcodec){
+  iter->vrecs = (mode == IMBATCH) ? batchnew(num) : Qnil;
+  iter->obj = obj;
+  iter->mode = mode;
+  iter->num = num;
+  iter->kcodec = kcodec;
+  iter->kxstr = tcxstrnew();
+  iter->vxstr = tcxstrnew();
+  iter->cur = NULL;
+  iter->recs = NULL;
+  iter->lxstr = NULL;
+  iter->view = false;
+  iter->vview = Qnil;
+  iter->reverse = false;
+  iter->max = -1;
+  iter->bkbuf = NULL;
+  iter->bksiz = 0;
+  iter->binc = false;
+  iter->ekbuf = NULL;
+  iter->eksiz = 0;
+  iter->einc = false;
+  iter->lid = 0;
+  iter->uid = 0;
+  iter->ids = NULL;
+  iter->rbuf = NULL;
+  iter->rsiz = 0;
+  iter->vrv = Qnil;
+}
+
+
+static void iteryield(ITERDATA *iter, const char *kbuf, int ksiz, const char *vbuf, int vsiz){
+  switch(iter->mode){
+  case IMKEY:
+    iter->vrv = rb_yield(buftovkey(kbuf, ksiz, iter->kcodec));
+    break;
+  case IMVALUE:
+    if(iter->view){
+      iter->vview = viewnew(vbuf, vsiz);
+      iter->vrv = rb_yield(iter->vview);
+      viewexpire(iter->vview);
+      iter->vview = Qnil;
+    } else {
+      iter->vrv = rb_yield(rb_str_new(vbuf, vsiz));
+    }
+    break;
+  case IMBATCH:
+    rb_ary_push(iter->vrecs, rb_assoc_new(buftovkey(kbuf, ksiz, iter->kcodec), rb_str_new(vbuf, vsiz)));
+    if(RARRAY_LEN(iter->vrecs) >= iter->num){
+      iter->vrv = rb_yield(iter->vrecs);
+      iter->vrecs = batchnew(iter->num);
+    }
+    break;
+  default:
+    if(iter->view){
+      iter->vview = viewnew(vbuf, vsiz);
+      iter->vrv = rb_yield_values(2, buftovkey(kbuf, ksiz, iter->kcodec), iter->vview);
+      viewexpire(iter->vview);
+      iter->vview = Qnil;
+    } else {
+      iter->vrv = rb_yield_values(2, buftovkey(kbuf, ksiz, iter->kcodec), rb_str_new(vbuf, vsiz));
+    }
+    break;
+  }
+}
+
+
+static VALUE iterfinish(ITERDATA *iter){
+  if(iter->mode == IMBATCH && RARRAY_LEN(iter->vrecs) > 0) iter->vrv = rb_yield(iter->vrecs);
+  return iter->vrv;
+}
+
+
+static VALUE iterfree(VALUE viter){
+  ITERDATA *iter;
+  iter = (ITERDATA *)viter;
+  if(iter->vview != Qnil) viewexpire(iter->vview);
+  if(iter->cur) tcbdbcurdel(iter->cur);
+  if(iter->recs) tclistdel(iter->recs);
+  if(iter->lxstr) tcxstrdel(iter->lxstr);
+  tcfree(iter->ekbuf);
+  tcfree(iter->bkbuf);
+  tcfree(iter->rbuf);
+  tcfree(iter->ids);
+  tcxstrdel(iter->vxstr);
+  tcxstrdel(iter->kxstr);
+  return Qnil;
+}
+
+
+static VALUE viewnew(const char *ptr, int size){
+  VALUE vview;
+  VIEWDATA *data;
+  data = tcmalloc(sizeof(*data));
+  vview = WrapDATA(cls_view, &view_type, data);
+  data->ptr = ptr;
+  data->size = size;
+  rb_obj_freeze(vview);
+  return vview;
+}
+
+
+static void viewexpire(VALUE vview){
+  VIEWDATA *data;
+  GetDATA(vview, VIEWDATA, &view_type, data);
+  data->ptr = NULL;
+  data->size = 0;
+}
+
+
+static void callblocking(void *(*func)(void *), BLOCKCALL *call, VALUE vkstr, VALUE vvstr){
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+  char kstack[BLOCKBUFSIZ], vstack[BLOCKBUFSIZ], *kcopy, *vcopy;
+  kcopy = NULL;
+  vcopy = NULL;
+  if(vkstr != Qnil && !OBJ_FROZEN(vkstr)){
+    if(call->ksiz < BLOCKBUFSIZ){
+      memcpy(kstack, call->kbuf, call->ksiz);
+      kstack[call->ksiz] = '\0';
+      call->kbuf = kstack;
+    } else {
+      call->kbuf = kcopy = tcmemdup(call->kbuf, call->ksiz);
+    }
+  }
+  if(vvstr != Qnil && !OBJ_FROZEN(vvstr)){
+    if(call->vsiz < BLOCKBUFSIZ){
+      memcpy(vstack, call->vbuf, call->vsiz);
+      vstack[call->vsiz] = '\0';
+      call->vbuf = vstack;
+    } else {
+      call->vbuf = vcopy = tcmemdup(call->vbuf, call->vsiz);
+    }
+  }
+  rb_thread_call_without_gvl(func, call, NULL, NULL);
+  tcfree(vcopy);
+  tcfree(kcopy);
+#else
+  func(call);
+#endif
+}
+
+
+static void qrycallblocking(TDBQRYDATA *data, void *(*func)(void *), BLOCKCALL *call,
+                            VALUE vkstr, VALUE vvstr){
+  QRYCALL qcall;
+  qcall.data = data;
+  qcall.func = func;
+  qcall.call = call;
+  qcall.vkstr = vkstr;
+  qcall.vvstr = vvstr;
+  data->busy = true;
+  rb_ensure(qrycallbody, (VALUE)&qcall, qrycallend, (VALUE)&qcall);
+}
+
+
+static VALUE qrycallbody(VALUE vqcall){
+  QRYCALL *qcall;
+  qcall = (QRYCALL *)vqcall;
+  callblocking(qcall->func, qcall->call, qcall->vkstr, qcall->vvstr);
+  return Qnil;
+}
+
+
+static VALUE qrycallend(VALUE vqcall){
+  QRYCALL *qcall;
+  qcall = (QRYCALL *)vqcall;
+  qcall->data->busy = false;
+  return Qnil;
+}
+
+
+static void *hdbopen_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->ok = tchdbopen(call->obj, call->kbuf, call->nums[0]);
+  return NULL;
+}
+
+
+static void *hdbget_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->rv = tchdbget(call->obj, call->kbuf, call->ksiz, &call->rsiz);
+  return NULL;
+}
+
+
+static void *hdbput_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->ok = tchdbput(call->obj, call->kbuf, call->ksiz, call->vbuf, call->vsiz);
+  return NULL;
+}
+
+
+static void *hdbsync_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->ok = tchdbsync(call->obj);
+  return NULL;
+}
+
+
+static void *hdboptimize_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->ok = tchdboptimize(call->obj, call->nums[0], call->nums[1], call->nums[2], call->nums[3]);
+  return NULL;
+}
+
+
+static void *hdbcopy_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->ok = tchdbcopy(call->obj, call->kbuf);
+  return NULL;
+}
+
+
+static void *bdbrange_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->rv = tcbdbrange(call->obj, call->kbuf, call->ksiz, call->nums[0],
+                        call->vbuf, call->vsiz, call->nums[1], call->nums[2]);
+  return NULL;
+}
+
+
+static void *tdbqrysearch_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  call->rv = tctdbqrysearch(call->obj);
+  return NULL;
+}
+
+
+static void *tdbqrycount_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  TCLIST *res;
+  res = tctdbqrysearch(call->obj);
+  call->nums[0] = tclistnum(res);
+  tclistdel(res);
+  return NULL;
+}
+
+
+static void *tdbqryfetch_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  TCLIST *pkeys = call->rv;
+  TCMAP **rows;
+  const char *pkbuf;
+  int i, num, pksiz;
+  num = tclistnum(pkeys) - call->nums[0];
+  if(num > call->nums[1]) num = call->nums[1];
+  if(num < 0) num = 0;
+  rows = tcmalloc(sizeof(*rows) * (num + 1));
+  for(i = 0; i < num; i++){
+    pkbuf = tclistval(pkeys, call->nums[0] + i, &pksiz);
+    rows[i] = tctdbget(call->obj, pkbuf, pksiz);
+  }
+  call->rv = rows;
+  call->rsiz = num;
+  return NULL;
+}
+
+
+static void *tdbqryagg_blocking(void *arg){
+  BLOCKCALL *call = arg;
+  AGGDATA *agg = call->rv;
+  TCLIST *res;
+  TCMAP *cols;
+  const char *pkbuf;
+  int i, num, pksiz;
+  agg->name = call->kbuf;
+  agg->nsiz = call->ksiz;
+  agg->gname = call->vbuf;
+  agg->gsiz = call->vsiz;
+  res = tctdbqrysearch(call->obj);
+  num = tclistnum(res);
+  for(i = 0; i < num; i++){
+    pkbuf = tclistval(res, i, &pksiz);
+    if(!(cols = tctdbget(agg->tdb, pkbuf, pksiz))) continue;
+    aggrec(agg, cols);
+    tcmapdel(cols);
+  }
+  tclistdel(res);
+  return NULL;
+}
+
+
+static bool pscanstart(PSCAN *scan, TCHDB *hdb, int tnum){
+  int i;
+  scan->hdb = hdb;
+  scan->threads = tcmalloc(sizeof(*scan->threads) * tnum);
+  scan->tnum = 0;
+  scan->live = 0;
+  pthread_mutex_init(&scan->mutex, NULL);
+  pthread_cond_init(&scan->cond, NULL);
+  scan->queue = tclistnew();
+  scan->recs = NULL;
+  scan->stop = false;
+  scan->intr = false;
+  scan->done = false;
+  tchdbiterinit(hdb);
+  pthread_mutex_lock(&scan->mutex);
+  for(i = 0; i < tnum; i++){
+    if(pthread_create(scan->threads + i, NULL, pscanwork, scan) != 0) break;
+    scan->tnum++;
+    scan->live++;
+  }
+  pthread_mutex_unlock(&scan->mutex);
+  return scan->tnum > 0;
+}
+
+
+static void *pscanwork(void *arg){
+  PSCAN *scan = arg;
+  char *kbuf, *vbuf;
+  int ksiz, vsiz;
+  bool stop;
+  while(true){
+    pthread_mutex_lock(&scan->mutex);
+    while(!scan->stop && tclistnum(scan->queue) >= PSCANQUEUE * 2){
+      pthread_cond_wait(&scan->cond, &scan->mutex);
+    }
+    stop = scan->stop;
+    pthread_mutex_unlock(&scan->mutex);
+    if(stop || !(kbuf = tchdbiternext(scan->hdb, &ksiz))) break;
+    if(!(vbuf = tchdbget(scan->hdb, kbuf, ksiz, &vsiz))){
+      tcfree(kbuf);
+      continue;
+    }
+    pthread_mutex_lock(&scan->mutex);
+    tclistpushmalloc(scan->queue, kbuf, ksiz);
+    tclistpushmalloc(scan->queue, vbuf, vsiz);
+    pthread_cond_broadcast(&scan->cond);
+    pthread_mutex_unlock(&scan->mutex);
+  }
+  pthread_mutex_lock(&scan->mutex);
+  scan->live--;
+  pthread_cond_broadcast(&scan->cond);
+  pthread_mutex_unlock(&scan->mutex);
+  return NULL;
+}
+
+
+static void *pscanwait(void *arg){
+  PSCAN *scan = arg;
+  pthread_mutex_lock(&scan->mutex);
+  while(tclistnum(scan->queue) < 1 && scan->live > 0 && !scan->intr){
+    pthread_cond_wait(&scan->cond, &scan->mutex);
+  }
+  scan->recs = scan->queue;
+  scan->queue = tclistnew();
+  scan->done = tclistnum(scan->recs) < 1 && scan->live < 1;
+  scan->intr = false;
+  pthread_cond_broadcast(&scan->cond);
+  pthread_mutex_unlock(&scan->mutex);
+  return NULL;
+}
+
+
+static void pscanintr(void *arg){
+  PSCAN *scan = arg;
+  pthread_mutex_lock(&scan->mutex);
+  scan->intr = true;
+  pthread_cond_broadcast(&scan->cond);
+  pthread_mutex_unlock(&scan->mutex);
+}
+
+
+static VALUE pscaniterate(VALUE vscan){
+  VALUE vrv;
+  PSCAN *scan;
+  const char *kbuf, *vbuf;
+  int i, num, ksiz, vsiz;
+  scan = (PSCAN *)vscan;
+  vrv = Qnil;
+  while(!scan->done){
+    if(scan->recs){
+      tclistdel(scan->recs);
+      scan->recs = NULL;
+    }
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+    rb_thread_call_without_gvl(pscanwait, scan, pscanintr, scan);
+#else
+    pscanwait(scan);
+#endif
+    num = tclistnum(scan->recs);
+    for(i = 0; i + 1 < num; i += 2){
+      kbuf = tclistval(scan->recs, i, &ksiz);
+      vbuf = tclistval(scan->recs, i + 1, &vsiz);
+      vrv = rb_yield_values(2, rb_str_new(kbuf, ksiz), rb_str_new(vbuf, vsiz));
+    }
+  }
+  return vrv;
+}
+
+
+static VALUE pscanfree(VALUE vscan){
+  PSCAN *scan;
+  int i;
+  scan = (PSCAN *)vscan;
+  pthread_mutex_lock(&scan->mutex);
+  scan->stop = true;
+  pthread_cond_broadcast(&scan->cond);
+  pthread_mutex_unlock(&scan->mutex);
+  for(i = 0; i < scan->tnum; i++){
+    pthread_join(scan->threads[i], NULL);
+  }
+  if(scan->recs) tclistdel(scan->recs);
+  tclistdel(scan->queue);
+  pthread_cond_destroy(&scan->cond);
+  pthread_mutex_destroy(&scan->mutex);
+  tcfree(scan->threads);
+  return Qnil;
+}
+
+
+static VALUE hscanpage(VALUE vscan){
+  HSCAN *scan;
+  VALUE vnext;
+  char *kbuf;
+  int ksiz;
+  scan = (HSCAN *)vscan;
+  while((scan->max < 0 || RARRAY_LEN(scan->vrecs) < scan->max) &&
+        tchdbiternext3(scan->hdb, scan->kxstr, scan->vxstr)){
+    rb_ary_push(scan->vrecs,
+                rb_assoc_new(rb_str_new(tcxstrptr(scan->kxstr), tcxstrsize(scan->kxstr)),
+                             rb_str_new(tcxstrptr(scan->vxstr), tcxstrsize(scan->vxstr))));
+  }
+  vnext = Qnil;
+  if(scan->max >= 0 && RARRAY_LEN(scan->vrecs) >= scan->max &&
+     (kbuf = tchdbiternext(scan->hdb, &ksiz)) != NULL){
+    vnext = rb_str_new(kbuf, ksiz);
+    tcfree(kbuf);
+    rb_obj_freeze(vnext);
+  }
+  return vnext;
+}
+
+
+static VALUE hscanfree(VALUE vscan){
+  HSCAN *scan;
+  scan = (HSCAN *)vscan;
+  scan->hdb->iter = scan->iter;
+  tcxstrdel(scan->vxstr);
+  tcxstrdel(scan->kxstr);
+  return Qnil;
+}
+
+
+static int vthreadsopt(VALUE vopts){
+  VALUE vtnum;
+  long tnum;
+  vtnum = vhashopt(vopts, "threads");
+  if(vtnum == Qnil){
+    tnum = sysconf(_SC_NPROCESSORS_ONLN);
+    return tnum > 0 ? tnum : 1;
+  }
+  tnum = NUM2INT(vtnum);
+  if(tnum < 1) rb_raise(rb_eArgError, "number of threads must be positive");
+  return tnum;
+}
+
+
 static void hdb_init(void){
   cls_hdb = rb_define_class_under(mod_tokyocabinet, "HDB", rb_cObject);
-  cls_hdb_data = rb_define_class_under(mod_tokyocabinet, "HDB_data", rb_cObject);
+  rb_define_alloc_func(cls_hdb, hdb_alloc);
   rb_define_const(cls_hdb, "ESUCCESS", INT2NUM(TCESUCCESS));
   rb_define_const(cls_hdb, "ETHREAD", INT2NUM(TCETHREAD));
   rb_define_const(cls_hdb, "EINVALID", INT2NUM(TCEINVALID));
@@ -449,7 +1690,7 @@ static void hdb_init(void){
   rb_define_const(cls_hdb, "ONOLCK", INT2NUM(HDBONOLCK));
   rb_define_const(cls_hdb, "OLCKNB", INT2NUM(HDBOLCKNB));
   rb_define_const(cls_hdb, "OTSYNC", INT2NUM(HDBOTSYNC));
-  rb_objc_define_method(cls_hdb, "initialize", hdb_initialize, 0);
+  rb_objc_define_method(cls_hdb, "initialize", hdb_initialize, -1);
   rb_objc_define_method(cls_hdb, "errmsg", hdb_errmsg, -1);
   rb_objc_define_method(cls_hdb, "ecode", hdb_ecode, 0);
   rb_objc_define_method(cls_hdb, "tune", hdb_tune, -1);
@@ -462,11 +1703,16 @@ static void hdb_init(void){
   rb_objc_define_method(cls_hdb, "putkeep", hdb_putkeep, 2);
   rb_objc_define_method(cls_hdb, "putcat", hdb_putcat, 2);
   rb_objc_define_method(cls_hdb, "putasync", hdb_putasync, 2);
+  rb_objc_define_method(cls_hdb, "put_all", hdb_put_all, -1);
   rb_objc_define_method(cls_hdb, "out", hdb_out, 1);
+  rb_objc_define_method(cls_hdb, "mout", hdb_mout, -1);
   rb_objc_define_method(cls_hdb, "get", hdb_get, 1);
+  rb_objc_define_method(cls_hdb, "mget", hdb_mget, 1);
+  rb_objc_define_method(cls_hdb, "get_into", hdb_get_into, 2);
   rb_objc_define_method(cls_hdb, "vsiz", hdb_vsiz, 1);
   rb_objc_define_method(cls_hdb, "iterinit", hdb_iterinit, 0);
   rb_objc_define_method(cls_hdb, "iternext", hdb_iternext, 0);
+  rb_objc_define_method(cls_hdb, "scan", hdb_scan, -1);
   rb_objc_define_method(cls_hdb, "fwmkeys", hdb_fwmkeys, -1);
   rb_objc_define_method(cls_hdb, "addint", hdb_addint, 2);
   rb_objc_define_method(cls_hdb, "adddouble", hdb_adddouble, 2);
@@ -496,51 +1742,65 @@ static void hdb_init(void){
   rb_objc_define_method(cls_hdb, "size", hdb_rnum, 0);
   rb_objc_define_method(cls_hdb, "length", hdb_rnum, 0);
   rb_objc_define_method(cls_hdb, "empty?", hdb_empty, 0);
-  rb_objc_define_method(cls_hdb, "each", hdb_each, 0);
-  rb_objc_define_method(cls_hdb, "each_pair", hdb_each, 0);
+  rb_objc_define_method(cls_hdb, "each", hdb_each, -1);
+  rb_objc_define_method(cls_hdb, "each_batch", hdb_each_batch, 1);
+  rb_objc_define_method(cls_hdb, "parallel_each", hdb_parallel_each, -1);
+  rb_objc_define_method(cls_hdb, "each_pair", hdb_each, -1);
   rb_objc_define_method(cls_hdb, "each_key", hdb_each_key, 0);
-  rb_objc_define_method(cls_hdb, "each_value", hdb_each_value, 0);
+  rb_objc_define_method(cls_hdb, "each_value", hdb_each_value, -1);
   rb_objc_define_method(cls_hdb, "keys", hdb_keys, 0);
   rb_objc_define_method(cls_hdb, "values", hdb_values, 0);
 }
 
 
-static VALUE hdb_initialize(VALUE vself, SEL sel){
-  VALUE vhdb;
-  TCHDB *hdb;
-  hdb = tchdbnew();
-  tchdbsetmutex(hdb);
-  vhdb = Data_Wrap_Struct(cls_hdb_data, 0, tchdbdel, hdb);
-  rb_iv_set(vself, HDBVNDATA, vhdb);
+static void hdb_free(HDBDATA *data){
+  tchdbdel(data->hdb);
+  tcfree(data);
+}
+
+
+static VALUE hdb_alloc(VALUE klass){
+  HDBDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->hdb = tchdbnew();
+  data->owner = Qnil;
+  return WrapDATA(klass, &hdb_type, data);
+}
+
+
+static VALUE hdb_initialize(RBVARARGS){
+  VALUE vopts;
+  HDBDATA *data;
+  rb_scan_args(argc, argv, "01", &vopts);
+  GetHDBDATA(vself, data);
+  data->owner = setowner(vself, vopts);
+  if(data->owner == Qnil) tchdbsetmutex(data->hdb);
   return Qnil;
 }
 
 
-static VALUE hdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vecode;
+static VALUE hdb_errmsg(RBVARARGS){
+  VALUE vecode;
   TCHDB *hdb;
   const char *msg;
   int ecode;
   rb_scan_args(argc, argv, "01", &vecode);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   ecode = (vecode == Qnil) ? tchdbecode(hdb) : NUM2INT(vecode);
   msg = tchdberrmsg(ecode);
   return rb_str_new2(msg);
 }
 
 
-static VALUE hdb_ecode(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_ecode(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return INT2NUM(tchdbecode(hdb));
 }
 
 
-static VALUE hdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vbnum, vapow, vfpow, vopts;
+static VALUE hdb_tune(RBVARARGS){
+  VALUE vbnum, vapow, vfpow, vopts;
   TCHDB *hdb;
   int apow, fpow, opts;
   int64_t bnum;
@@ -549,169 +1809,294 @@ static VALUE hdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? 0 : NUM2INT(vopts);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbtune(hdb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vrcnum;
+static VALUE hdb_setcache(RBVARARGS){
+  VALUE vrcnum;
   TCHDB *hdb;
   int rcnum;
   rb_scan_args(argc, argv, "01", &vrcnum);
   rcnum = (vrcnum == Qnil) ? -1 : NUM2INT(vrcnum);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbsetcache(hdb, rcnum) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vxmsiz;
+static VALUE hdb_setxmsiz(RBVARARGS){
+  VALUE vxmsiz;
   TCHDB *hdb;
   int64_t xmsiz;
   rb_scan_args(argc, argv, "01", &vxmsiz);
   xmsiz = (vxmsiz == Qnil) ? -1 : NUM2LL(vxmsiz);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbsetxmsiz(hdb, xmsiz) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vdfunit;
+static VALUE hdb_setdfunit(RBVARARGS){
+  VALUE vdfunit;
   TCHDB *hdb;
   int32_t dfunit;
   rb_scan_args(argc, argv, "01", &vdfunit);
   dfunit = (vdfunit == Qnil) ? -1 : NUM2INT(vdfunit);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbsetdfunit(hdb, dfunit) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_open(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vpath, vomode;
+static VALUE hdb_open(RBVARARGS){
+  VALUE vpath, vomode;
   TCHDB *hdb;
+  BLOCKCALL call;
   int omode;
   rb_scan_args(argc, argv, "11", &vpath, &vomode);
   Check_Type(vpath, T_STRING);
   omode = (vomode == Qnil) ? HDBOREADER : NUM2INT(vomode);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbopen(hdb, RSTRING_PTR(vpath), omode) ? Qtrue : Qfalse;
+  GetHDB(vself, hdb);
+  call.obj = hdb;
+  call.kbuf = RSTRING_PTR(vpath);
+  call.ksiz = RSTRING_LEN(vpath);
+  call.nums[0] = omode;
+  callblocking(hdbopen_blocking, &call, vpath, Qnil);
+  return call.ok ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_close(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_close(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbclose(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vhdb;
+static VALUE hdb_put(RBSELF, VALUE vkey, VALUE vval){
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbput(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                  RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  BLOCKCALL call;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
+  if(val.size < BLOCKVSIZ) return tchdbput(hdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+  call.obj = hdb;
+  call.kbuf = key.ptr;
+  call.ksiz = key.size;
+  call.vbuf = val.ptr;
+  call.vsiz = val.size;
+  callblocking(hdbput_blocking, &call, key.vstr, val.vstr);
+  return call.ok ? Qtrue : Qfalse;
+}
+
+
+static VALUE hdb_putkeep(RBSELF, VALUE vkey, VALUE vval){
+  TCHDB *hdb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
+  return tchdbputkeep(hdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vhdb;
+static VALUE hdb_putcat(RBSELF, VALUE vkey, VALUE vval){
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbputkeep(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                      RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
+  return tchdbputcat(hdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vhdb;
+static VALUE hdb_putasync(RBSELF, VALUE vkey, VALUE vval){
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbputcat(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                     RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
+  return tchdbputasync(hdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_putasync(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vhdb;
+static VALUE hdb_put_all(RBVARARGS){
+  VALUE vrecs, vopts, vkey, vfails;
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbputasync(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                       RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  int i, num, mode, cnt;
+  bool tran, ok;
+  rb_scan_args(argc, argv, "11", &vrecs, &vopts);
+  mode = vputmode(vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetHDB(vself, hdb);
+  vrecs = vrecstoary(vrecs, KCSTRING);
+  if(tran && !tchdbtranbegin(hdb)) return Qnil;
+  vfails = rb_ary_new();
+  cnt = 0;
+  num = RARRAY_LEN(vrecs);
+  for(i = 0; i < num; i += 2){
+    vkey = rb_ary_entry(vrecs, i);
+    StringValueBuf(vkey, &key);
+    StringValueBuf(rb_ary_entry(vrecs, i + 1), &val);
+    switch(mode){
+    case PMKEEP:
+      ok = tchdbputkeep(hdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    case PMCAT:
+      ok = tchdbputcat(hdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    default:
+      ok = tchdbput(hdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    }
+    if(ok){
+      cnt++;
+    } else {
+      rb_ary_push(vfails, vkey);
+    }
+  }
+  if(tran && !tchdbtrancommit(hdb)){
+    tchdbtranabort(hdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vfails);
+}
+
+
+static VALUE hdb_out(RBSELF, VALUE vkey){
+  TCHDB *hdb;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  return tchdbout(hdb, key.ptr, key.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE hdb_mout(RBVARARGS){
+  VALUE vkeys, vopts, vkey, vmiss;
+  TCHDB *hdb;
+  VALBUF key;
+  int i, num, cnt;
+  bool tran, err;
+  rb_scan_args(argc, argv, "11", &vkeys, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetHDB(vself, hdb);
+  vkeys = vkeystoary(vkeys, KCSTRING);
+  if(tran && !tchdbtranbegin(hdb)) return Qnil;
+  vmiss = rb_ary_new();
+  cnt = 0;
+  err = false;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if(tchdbout(hdb, key.ptr, key.size)){
+      cnt++;
+    } else if(tchdbecode(hdb) == TCENOREC){
+      rb_ary_push(vmiss, vkey);
+    } else {
+      err = true;
+      break;
+    }
+  }
+  if(err){
+    if(tran) tchdbtranabort(hdb);
+    return Qnil;
+  }
+  if(tran && !tchdbtrancommit(hdb)){
+    tchdbtranabort(hdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vmiss);
 }
 
 
-static VALUE hdb_out(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vhdb;
+static VALUE hdb_get(RBSELF, VALUE vkey){
+  VALUE vval;
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbout(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  BLOCKCALL call;
+  char *vbuf;
+  int vsiz;
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  call.obj = hdb;
+  call.kbuf = key.ptr;
+  call.ksiz = key.size;
+  callblocking(hdbget_blocking, &call, key.vstr, Qnil);
+  vbuf = call.rv;
+  vsiz = call.rsiz;
+  if(!vbuf) return Qnil;
+  vval = rb_str_new(vbuf, vsiz);
+  tcfree(vbuf);
+  return vval;
+}
+
+
+static VALUE hdb_mget(RBSELF, VALUE vkeys){
+  VALUE vkey, vhash;
+  TCHDB *hdb;
+  VALBUF key;
+  char *vbuf;
+  int i, num, vsiz;
+  Check_Type(vkeys, T_ARRAY);
+  GetHDB(vself, hdb);
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if((vbuf = tchdbget(hdb, key.ptr, key.size, &vsiz)) != NULL){
+      rb_hash_aset(vhash, vkey, rb_str_new(vbuf, vsiz));
+      tcfree(vbuf);
+    }
+  }
+  return vhash;
 }
 
 
-static VALUE hdb_get(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vhdb, vval;
+static VALUE hdb_get_into(RBSELF, VALUE vkey, VALUE vbuf){
   TCHDB *hdb;
-  char *vbuf;
-  int vsiz;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  if(!(vbuf = tchdbget(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz))) return Qnil;
-  vval = rb_str_new(vbuf, vsiz);
-  tcfree(vbuf);
-  return vval;
+  VALBUF key;
+  char *buf;
+  int max, vsiz;
+  if(vbuf == vkey) rb_raise(rb_eArgError, "the buffer must not be the key");
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  buf = vstrreserve(vbuf, 0, &max);
+  if((vsiz = tchdbget3(hdb, key.ptr, key.size, buf, max)) < 0) return Qnil;
+  if(vsiz >= max && (vsiz = tchdbvsiz(hdb, key.ptr, key.size)) > max){
+    buf = vstrreserve(vbuf, vsiz, &max);
+    if((vsiz = tchdbget3(hdb, key.ptr, key.size, buf, max)) < 0) return Qnil;
+  }
+  vstrsetlen(vbuf, vsiz);
+  return vbuf;
 }
 
 
-static VALUE hdb_vsiz(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vhdb;
+static VALUE hdb_vsiz(RBSELF, VALUE vkey){
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return INT2NUM(tchdbvsiz(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)));
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  return INT2NUM(tchdbvsiz(hdb, key.ptr, key.size));
 }
 
 
-static VALUE hdb_iterinit(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_iterinit(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbiterinit(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_iternext(VALUE vself, SEL sel){
-  VALUE vhdb, vval;
+static VALUE hdb_iternext(RBSELF){
+  VALUE vval;
   TCHDB *hdb;
   char *vbuf;
   int vsiz;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   if(!(vbuf = tchdbiternext(hdb, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
@@ -719,59 +2104,87 @@ static VALUE hdb_iternext(VALUE vself, SEL sel){
 }
 
 
-static VALUE hdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vprefix, vmax, vary;
+static VALUE hdb_scan(RBVARARGS){
+  VALUE vtoken, vmax, vrecs, vnext;
+  TCHDB *hdb;
+  HSCAN scan;
+  VALBUF token;
+  int max;
+  uint64_t iter;
+  rb_scan_args(argc, argv, "02", &vtoken, &vmax);
+  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
+  if(vtoken != Qnil) StringValueBuf(vtoken, &token);
+  GetHDB(vself, hdb);
+  vrecs = rb_ary_new();
+  iter = hdb->iter;
+  if(vtoken == Qnil ? !tchdbiterinit(hdb) : !tchdbiterinit2(hdb, token.ptr, token.size)){
+    hdb->iter = iter;
+    return Qnil;
+  }
+  scan.hdb = hdb;
+  scan.iter = iter;
+  scan.max = max;
+  scan.kxstr = tcxstrnew();
+  scan.vxstr = tcxstrnew();
+  scan.vrecs = vrecs;
+  vnext = rb_ensure(hscanpage, (VALUE)&scan, hscanfree, (VALUE)&scan);
+  return rb_assoc_new(vrecs, vnext);
+}
+
+
+static VALUE hdb_fwmkeys(RBVARARGS){
+  VALUE vprefix, vmax, vary;
   TCHDB *hdb;
   TCLIST *keys;
+  VALBUF prefix;
   int max;
   rb_scan_args(argc, argv, "11", &vprefix, &vmax);
-  vprefix = StringValueEx(vprefix);
+  StringValueBuf(vprefix, &prefix);
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  keys = tchdbfwmkeys(hdb, RSTRING_PTR(vprefix), RSTRING_LEN(vprefix), max);
+  GetHDB(vself, hdb);
+  keys = tchdbfwmkeys(hdb, prefix.ptr, prefix.size, max);
   vary = listtovary(keys);
   tclistdel(keys);
   return vary;
 }
 
 
-static VALUE hdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vhdb;
+static VALUE hdb_addint(RBSELF, VALUE vkey, VALUE vnum){
   TCHDB *hdb;
+  VALBUF key;
   int num;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  num = tchdbaddint(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2INT(vnum));
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  num = tchdbaddint(hdb, key.ptr, key.size, NUM2INT(vnum));
   return num == INT_MIN ? Qnil : INT2NUM(num);
 }
 
 
-static VALUE hdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vhdb;
+static VALUE hdb_adddouble(RBSELF, VALUE vkey, VALUE vnum){
   TCHDB *hdb;
+  VALBUF key;
   double num;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  num = tchdbadddouble(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2DBL(vnum));
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  num = tchdbadddouble(hdb, key.ptr, key.size, NUM2DBL(vnum));
   return isnan(num) ? Qnil : rb_float_new(num);
 }
 
 
-static VALUE hdb_sync(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_sync(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbsync(hdb) ? Qtrue : Qfalse;
+  BLOCKCALL call;
+  GetHDB(vself, hdb);
+  call.obj = hdb;
+  callblocking(hdbsync_blocking, &call, Qnil, Qnil);
+  return call.ok ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vbnum, vapow, vfpow, vopts;
+static VALUE hdb_optimize(RBVARARGS){
+  VALUE vbnum, vapow, vfpow, vopts;
   TCHDB *hdb;
+  BLOCKCALL call;
   int apow, fpow, opts;
   int64_t bnum;
   rb_scan_args(argc, argv, "04", &vbnum, &vapow, &vfpow, &vopts);
@@ -779,97 +2192,91 @@ static VALUE hdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? UINT8_MAX : NUM2INT(vopts);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdboptimize(hdb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
+  GetHDB(vself, hdb);
+  call.obj = hdb;
+  call.nums[0] = bnum;
+  call.nums[1] = apow;
+  call.nums[2] = fpow;
+  call.nums[3] = opts;
+  callblocking(hdboptimize_blocking, &call, Qnil, Qnil);
+  return call.ok ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_vanish(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_vanish(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbvanish(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_copy(VALUE vself, SEL sel, VALUE vpath){
-  VALUE vhdb;
+static VALUE hdb_copy(RBSELF, VALUE vpath){
   TCHDB *hdb;
+  BLOCKCALL call;
   Check_Type(vpath, T_STRING);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbcopy(hdb, RSTRING_PTR(vpath)) ? Qtrue : Qfalse;
+  GetHDB(vself, hdb);
+  call.obj = hdb;
+  call.kbuf = RSTRING_PTR(vpath);
+  call.ksiz = RSTRING_LEN(vpath);
+  callblocking(hdbcopy_blocking, &call, vpath, Qnil);
+  return call.ok ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_tranbegin(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_tranbegin(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbtranbegin(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_trancommit(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_trancommit(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbtrancommit(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_tranabort(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_tranabort(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbtranabort(hdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_path(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_path(RBSELF){
   TCHDB *hdb;
   const char *path;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   if(!(path = tchdbpath(hdb))) return Qnil;
   return rb_str_new2(path);
 }
 
 
-static VALUE hdb_rnum(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_rnum(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return LL2NUM(tchdbrnum(hdb));
 }
 
 
-static VALUE hdb_fsiz(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_fsiz(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return LL2NUM(tchdbfsiz(hdb));
 }
 
 
-static VALUE hdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vhdb, vkey, vdef, vval;
+static VALUE hdb_fetch(RBVARARGS){
+  VALUE vkey, vdef, vval;
   TCHDB *hdb;
+  VALBUF key;
   char *vbuf;
   int vsiz;
   rb_scan_args(argc, argv, "11", &vkey, &vdef);
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  if((vbuf = tchdbget(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz)) != NULL){
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  if((vbuf = tchdbget(hdb, key.ptr, key.size, &vsiz)) != NULL){
     vval = rb_str_new(vbuf, vsiz);
     tcfree(vbuf);
   } else {
@@ -879,31 +2286,29 @@ static VALUE hdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE hdb_check(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vhdb;
+static VALUE hdb_check(RBSELF, VALUE vkey){
   TCHDB *hdb;
-  vkey = StringValueEx(vkey);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  return tchdbvsiz(hdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) >= 0 ? Qtrue : Qfalse;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetHDB(vself, hdb);
+  return tchdbvsiz(hdb, key.ptr, key.size) >= 0 ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_check_value(VALUE vself, SEL sel, VALUE vval){
-  VALUE vhdb;
+static VALUE hdb_check_value(RBSELF, VALUE vval){
   TCHDB *hdb;
   TCXSTR *kxstr, *vxstr;
+  VALBUF val;
   bool hit;
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
   hit = false;
   kxstr = tcxstrnew();
   vxstr = tcxstrnew();
   tchdbiterinit(hdb);
   while(tchdbiternext3(hdb, kxstr, vxstr)){
-    if(tcxstrsize(vxstr) == RSTRING_LEN(vval) &&
-       memcmp(tcxstrptr(vxstr), RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tcxstrsize(vxstr) == val.size &&
+       memcmp(tcxstrptr(vxstr), val.ptr, val.size) == 0){
       hit = true;
       break;
     }
@@ -914,20 +2319,20 @@ static VALUE hdb_check_value(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE hdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
-  VALUE vhdb, vrv;
+static VALUE hdb_get_reverse(RBSELF, VALUE vval){
+  VALUE vrv;
   TCHDB *hdb;
   TCXSTR *kxstr, *vxstr;
-  vval = StringValueEx(vval);
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  VALBUF val;
+  StringValueBuf(vval, &val);
+  GetHDB(vself, hdb);
   vrv = Qnil;
   kxstr = tcxstrnew();
   vxstr = tcxstrnew();
   tchdbiterinit(hdb);
   while(tchdbiternext3(hdb, kxstr, vxstr)){
-    if(tcxstrsize(vxstr) == RSTRING_LEN(vval) &&
-       memcmp(tcxstrptr(vxstr), RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tcxstrsize(vxstr) == val.size &&
+       memcmp(tcxstrptr(vxstr), val.ptr, val.size) == 0){
       vrv = rb_str_new(tcxstrptr(kxstr), tcxstrsize(kxstr));
       break;
     }
@@ -938,117 +2343,113 @@ static VALUE hdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE hdb_empty(VALUE vself, SEL sel){
-  VALUE vhdb;
+static VALUE hdb_empty(RBSELF){
   TCHDB *hdb;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
+  GetHDB(vself, hdb);
   return tchdbrnum(hdb) < 1 ? Qtrue : Qfalse;
 }
 
 
-static VALUE hdb_each(VALUE vself, SEL sel){
-  VALUE vhdb, vrv;
-  TCHDB *hdb;
-  TCXSTR *kxstr, *vxstr;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  vrv = Qnil;
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  tchdbiterinit(hdb);
-  while(tchdbiternext3(hdb, kxstr, vxstr)){
-    vrv = rb_yield_values(2, rb_str_new(tcxstrptr(kxstr), tcxstrsize(kxstr)),
-                          rb_str_new(tcxstrptr(vxstr), tcxstrsize(vxstr)));
+static VALUE hdb_iterate(VALUE viter){
+  ITERDATA *iter;
+  iter = (ITERDATA *)viter;
+  tchdbiterinit(iter->obj);
+  while(tchdbiternext3(iter->obj, iter->kxstr, iter->vxstr)){
+    iteryield(iter, tcxstrptr(iter->kxstr), tcxstrsize(iter->kxstr),
+              tcxstrptr(iter->vxstr), tcxstrsize(iter->vxstr));
   }
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vrv;
+  return iterfinish(iter);
 }
 
 
-static VALUE hdb_each_key(VALUE vself, SEL sel){
-  VALUE vhdb, vrv;
+static VALUE hdb_each(RBVARARGS){
   TCHDB *hdb;
-  TCXSTR *kxstr, *vxstr;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  vrv = Qnil;
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  tchdbiterinit(hdb);
-  while(tchdbiternext3(hdb, kxstr, vxstr)){
-    vrv = rb_yield(rb_str_new(tcxstrptr(kxstr), tcxstrsize(kxstr)));
-  }
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vrv;
+  VALUE vopts;
+  ITERDATA iter;
+  bool view;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each", argc, argv, true);
+  GetHDB(vself, hdb);
+  view = vhashopt(vopts, "view") == Qtrue;
+  iterinit(&iter, hdb, IMPAIR, 0, KCSTRING);
+  iter.view = view;
+  return rb_ensure(hdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
 }
 
 
-static VALUE hdb_each_value(VALUE vself, SEL sel){
-  VALUE vhdb, vrv;
+static VALUE hdb_each_batch(RBSELF, VALUE vnum){
   TCHDB *hdb;
-  TCXSTR *kxstr, *vxstr;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  vrv = Qnil;
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  tchdbiterinit(hdb);
-  while(tchdbiternext3(hdb, kxstr, vxstr)){
-    vrv = rb_yield(rb_str_new(tcxstrptr(vxstr), tcxstrsize(vxstr)));
+  ITERDATA iter;
+  int num;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  GetHDB(vself, hdb);
+  iterinit(&iter, hdb, IMBATCH, num, KCSTRING);
+  return rb_ensure(hdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE hdb_parallel_each(RBVARARGS){
+  VALUE vopts;
+  HDBDATA *data;
+  ITERDATA iter;
+  PSCAN scan;
+  int tnum;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "parallel_each", argc, argv, true);
+  tnum = vthreadsopt(vopts);
+  GetHDBDATA(vself, data);
+  if(data->owner != Qnil){
+    iterinit(&iter, data->hdb, IMPAIR, 0, KCSTRING);
+    return rb_ensure(hdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
   }
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vrv;
+  if(!pscanstart(&scan, data->hdb, tnum)){
+    pscanfree((VALUE)&scan);
+    rb_raise(rb_eThreadError, "cannot create a scanning thread");
+  }
+  return rb_ensure(pscaniterate, (VALUE)&scan, pscanfree, (VALUE)&scan);
 }
 
 
-static VALUE hdb_keys(VALUE vself, SEL sel){
-  VALUE vhdb, vary;
+static VALUE hdb_each_key(RBSELF){
   TCHDB *hdb;
-  TCXSTR *kxstr, *vxstr;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  vary = rb_ary_new2(tchdbrnum(hdb));
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  tchdbiterinit(hdb);
-  while(tchdbiternext3(hdb, kxstr, vxstr)){
-    rb_ary_push(vary, rb_str_new(tcxstrptr(kxstr), tcxstrsize(kxstr)));
-  }
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vary;
+  ITERDATA iter;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_key", 0, NULL, true);
+  GetHDB(vself, hdb);
+  iterinit(&iter, hdb, IMKEY, 0, KCSTRING);
+  return rb_ensure(hdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
 }
 
 
-static VALUE hdb_values(VALUE vself, SEL sel){
-  VALUE vhdb, vary;
+static VALUE hdb_each_value(RBVARARGS){
   TCHDB *hdb;
-  TCXSTR *kxstr, *vxstr;
-  vhdb = rb_iv_get(vself, HDBVNDATA);
-  Data_Get_Struct(vhdb, TCHDB, hdb);
-  vary = rb_ary_new2(tchdbrnum(hdb));
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  tchdbiterinit(hdb);
-  while(tchdbiternext3(hdb, kxstr, vxstr)){
-    rb_ary_push(vary, rb_str_new(tcxstrptr(vxstr), tcxstrsize(vxstr)));
-  }
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vary;
+  VALUE vopts;
+  ITERDATA iter;
+  bool view;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_value", argc, argv, true);
+  GetHDB(vself, hdb);
+  view = vhashopt(vopts, "view") == Qtrue;
+  iterinit(&iter, hdb, IMVALUE, 0, KCSTRING);
+  iter.view = view;
+  return rb_ensure(hdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE hdb_keys(RBSELF){
+  return vnewenum(vself, "each_key", 0, NULL, true);
+}
+
+
+static VALUE hdb_values(RBSELF){
+  return vnewenum(vself, "each_value", 0, NULL, true);
 }
 
 
 static void bdb_init(void){
   cls_bdb = rb_define_class_under(mod_tokyocabinet, "BDB", rb_cObject);
-  cls_bdb_data = rb_define_class_under(mod_tokyocabinet, "BDB_data", rb_cObject);
+  rb_define_alloc_func(cls_bdb, bdb_alloc);
   bdb_cmp_call_mid = rb_intern("call");
   rb_define_const(cls_bdb, "ESUCCESS", INT2NUM(TCESUCCESS));
   rb_define_const(cls_bdb, "ETHREAD", INT2NUM(TCETHREAD));
@@ -1089,7 +2490,7 @@ static void bdb_init(void){
   rb_define_const(cls_bdb, "ONOLCK", INT2NUM(BDBONOLCK));
   rb_define_const(cls_bdb, "OLCKNB", INT2NUM(BDBOLCKNB));
   rb_define_const(cls_bdb, "OTSYNC", INT2NUM(BDBOTSYNC));
-  rb_objc_define_method(cls_bdb, "initialize", bdb_initialize, 0);
+  rb_objc_define_method(cls_bdb, "initialize", bdb_initialize, -1);
   rb_objc_define_method(cls_bdb, "errmsg", bdb_errmsg, -1);
   rb_objc_define_method(cls_bdb, "ecode", bdb_ecode, 0);
   rb_objc_define_method(cls_bdb, "setcmpfunc", bdb_setcmpfunc, 1);
@@ -1104,9 +2505,14 @@ static void bdb_init(void){
   rb_objc_define_method(cls_bdb, "putcat", bdb_putcat, 2);
   rb_objc_define_method(cls_bdb, "putdup", bdb_putdup, 2);
   rb_objc_define_method(cls_bdb, "putlist", bdb_putlist, 2);
+  rb_objc_define_method(cls_bdb, "put_all", bdb_put_all, -1);
+  rb_objc_define_method(cls_bdb, "bulk_load", bdb_bulk_load, -1);
   rb_objc_define_method(cls_bdb, "out", bdb_out, 1);
   rb_objc_define_method(cls_bdb, "outlist", bdb_outlist, 1);
+  rb_objc_define_method(cls_bdb, "mout", bdb_mout, -1);
   rb_objc_define_method(cls_bdb, "get", bdb_get, 1);
+  rb_objc_define_method(cls_bdb, "mget", bdb_mget, 1);
+  rb_objc_define_method(cls_bdb, "get_into", bdb_get_into, 2);
   rb_objc_define_method(cls_bdb, "getlist", bdb_getlist, 1);
   rb_objc_define_method(cls_bdb, "vnum", bdb_vnum, 1);
   rb_objc_define_method(cls_bdb, "vsiz", bdb_vsiz, 1);
@@ -1140,12 +2546,17 @@ static void bdb_init(void){
   rb_objc_define_method(cls_bdb, "size", bdb_rnum, 0);
   rb_objc_define_method(cls_bdb, "length", bdb_rnum, 0);
   rb_objc_define_method(cls_bdb, "empty?", bdb_empty, 0);
-  rb_objc_define_method(cls_bdb, "each", bdb_each, 0);
-  rb_objc_define_method(cls_bdb, "each_pair", bdb_each, 0);
+  rb_objc_define_method(cls_bdb, "each", bdb_each, -1);
+  rb_objc_define_method(cls_bdb, "each_batch", bdb_each_batch, 1);
+  rb_objc_define_method(cls_bdb, "each_range", bdb_each_range, -1);
+  rb_objc_define_method(cls_bdb, "each_reverse", bdb_each_reverse, -1);
+  rb_objc_define_method(cls_bdb, "each_pair", bdb_each, -1);
   rb_objc_define_method(cls_bdb, "each_key", bdb_each_key, 0);
-  rb_objc_define_method(cls_bdb, "each_value", bdb_each_value, 0);
+  rb_objc_define_method(cls_bdb, "each_value", bdb_each_value, -1);
   rb_objc_define_method(cls_bdb, "keys", bdb_keys, 0);
   rb_objc_define_method(cls_bdb, "values", bdb_values, 0);
+  rb_objc_define_method(cls_bdb, "key_codec", bdb_kcodec, 0);
+  rb_objc_define_method(cls_bdb, "key_codec=", bdb_setkcodec, 1);
 }
 
 
@@ -1156,42 +2567,54 @@ static int bdb_cmpobj(const char *aptr, int asiz, const char *bptr, int bsiz, VA
 }
 
 
-static VALUE bdb_initialize(VALUE vself, SEL sel){
-  VALUE vbdb;
-  TCBDB *bdb;
-  bdb = tcbdbnew();
-  tcbdbsetmutex(bdb);
-  vbdb = Data_Wrap_Struct(cls_bdb_data, 0, tcbdbdel, bdb);
-  rb_iv_set(vself, BDBVNDATA, vbdb);
+static void bdb_free(BDBDATA *data){
+  tcbdbdel(data->bdb);
+  tcfree(data);
+}
+
+
+static VALUE bdb_alloc(VALUE klass){
+  BDBDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->bdb = tcbdbnew();
+  data->owner = Qnil;
+  data->kcodec = KCSTRING;
+  return WrapDATA(klass, &bdb_type, data);
+}
+
+
+static VALUE bdb_initialize(RBVARARGS){
+  VALUE vopts;
+  BDBDATA *data;
+  rb_scan_args(argc, argv, "01", &vopts);
+  GetBDBDATA(vself, data);
+  data->owner = setowner(vself, vopts);
+  if(data->owner == Qnil) tcbdbsetmutex(data->bdb);
   return Qnil;
 }
 
 
-static VALUE bdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vecode;
+static VALUE bdb_errmsg(RBVARARGS){
+  VALUE vecode;
   TCBDB *bdb;
   const char *msg;
   int ecode;
   rb_scan_args(argc, argv, "01", &vecode);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   ecode = (vecode == Qnil) ? tcbdbecode(bdb) : NUM2INT(vecode);
   msg = tcbdberrmsg(ecode);
   return rb_str_new2(msg);
 }
 
 
-static VALUE bdb_ecode(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_ecode(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return INT2NUM(tcbdbecode(bdb));
 }
 
 
-static VALUE bdb_setcmpfunc(VALUE vself, SEL sel, VALUE vcmp){
-  VALUE vbdb;
+static VALUE bdb_setcmpfunc(RBSELF, VALUE vcmp){
   TCBDB *bdb;
   TCCMP cmp;
   cmp = (TCCMP)bdb_cmpobj;
@@ -1210,14 +2633,13 @@ static VALUE bdb_setcmpfunc(VALUE vself, SEL sel, VALUE vcmp){
   } else if(!rb_respond_to(vcmp, bdb_cmp_call_mid)){
     rb_raise(rb_eArgError, "call method is not implemented");
   }
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbsetcmpfunc(bdb, cmp, (void *)(intptr_t)vcmp);
 }
 
 
-static VALUE bdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vlmemb, vnmemb, vbnum, vapow, vfpow, vopts;
+static VALUE bdb_tune(RBVARARGS){
+  VALUE vlmemb, vnmemb, vbnum, vapow, vfpow, vopts;
   TCBDB *bdb;
   int lmemb, nmemb, apow, fpow, opts;
   int64_t bnum;
@@ -1228,291 +2650,532 @@ static VALUE bdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? 0 : NUM2INT(vopts);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbtune(bdb, lmemb, nmemb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vlcnum, vncnum;
+static VALUE bdb_setcache(RBVARARGS){
+  VALUE vlcnum, vncnum;
   TCBDB *bdb;
   int lcnum, ncnum;
   rb_scan_args(argc, argv, "02", &vlcnum, &vncnum);
   lcnum = (vlcnum == Qnil) ? -1 : NUM2INT(vlcnum);
   ncnum = (vncnum == Qnil) ? -1 : NUM2INT(vncnum);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbsetcache(bdb, lcnum, ncnum);
 }
 
 
-static VALUE bdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vxmsiz;
+static VALUE bdb_setxmsiz(RBVARARGS){
+  VALUE vxmsiz;
   TCBDB *bdb;
   int64_t xmsiz;
   rb_scan_args(argc, argv, "01", &vxmsiz);
   xmsiz = (vxmsiz == Qnil) ? -1 : NUM2LL(vxmsiz);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbsetxmsiz(bdb, xmsiz) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vdfunit;
+static VALUE bdb_setdfunit(RBVARARGS){
+  VALUE vdfunit;
   TCBDB *bdb;
   int32_t dfunit;
   rb_scan_args(argc, argv, "01", &vdfunit);
   dfunit = (vdfunit == Qnil) ? -1 : NUM2INT(vdfunit);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbsetdfunit(bdb, dfunit) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_open(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vpath, vomode;
+static VALUE bdb_open(RBVARARGS){
+  VALUE vpath, vomode;
   TCBDB *bdb;
   int omode;
   rb_scan_args(argc, argv, "11", &vpath, &vomode);
   Check_Type(vpath, T_STRING);
   omode = (vomode == Qnil) ? BDBOREADER : NUM2INT(vomode);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbopen(bdb, RSTRING_PTR(vpath), omode) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_close(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_close(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbclose(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vbdb;
+static VALUE bdb_put(RBSELF, VALUE vkey, VALUE vval){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbput(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval),
-                  RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  StringValueBuf(vval, &val);
+  return tcbdbput(bdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vbdb;
+static VALUE bdb_putkeep(RBSELF, VALUE vkey, VALUE vval){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbputkeep(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval),
-                      RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  StringValueBuf(vval, &val);
+  return tcbdbputkeep(bdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vbdb;
+static VALUE bdb_putcat(RBSELF, VALUE vkey, VALUE vval){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbputcat(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval),
-                     RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  StringValueBuf(vval, &val);
+  return tcbdbputcat(bdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_putdup(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vbdb;
+static VALUE bdb_putdup(RBSELF, VALUE vkey, VALUE vval){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbputdup(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval),
-                     RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  StringValueBuf(vval, &val);
+  return tcbdbputdup(bdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_putlist(VALUE vself, SEL sel, VALUE vkey, VALUE vvals){
-  VALUE vbdb;
+static VALUE bdb_putlist(RBSELF, VALUE vkey, VALUE vvals){
+  BDBDATA *data;
   TCBDB *bdb;
   TCLIST *tvals;
+  VALBUF key;
   bool err;
-  vkey = StringValueEx(vkey);
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
   Check_Type(vvals, T_ARRAY);
   tvals = varytolist(vvals);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
   err = false;
-  if(!tcbdbputdup3(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), tvals)) err = true;
+  if(!tcbdbputdup3(bdb, key.ptr, key.size, tvals)) err = true;
   tclistdel(tvals);
   return err ? Qfalse : Qtrue;
 }
 
 
-static VALUE bdb_out(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_put_all(RBVARARGS){
+  VALUE vrecs, vopts, vkey, vfails;
+  BDBDATA *data;
+  TCBDB *bdb;
+  VALBUF key, val;
+  int i, num, mode, cnt;
+  bool tran, ok;
+  rb_scan_args(argc, argv, "11", &vrecs, &vopts);
+  mode = vputmode(vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vrecs = vrecstoary(vrecs, data->kcodec);
+  if(tran && !tcbdbtranbegin(bdb)) return Qnil;
+  vfails = rb_ary_new();
+  cnt = 0;
+  num = RARRAY_LEN(vrecs);
+  for(i = 0; i < num; i += 2){
+    vkey = rb_ary_entry(vrecs, i);
+    vkeytobuf(vkey, data->kcodec, &key);
+    StringValueBuf(rb_ary_entry(vrecs, i + 1), &val);
+    switch(mode){
+    case PMKEEP:
+      ok = tcbdbputkeep(bdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    case PMCAT:
+      ok = tcbdbputcat(bdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    default:
+      ok = tcbdbput(bdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    }
+    if(ok){
+      cnt++;
+    } else {
+      rb_ary_push(vfails, vkey);
+    }
+  }
+  if(tran && !tcbdbtrancommit(bdb)){
+    tcbdbtranabort(bdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vfails);
+}
+
+
+static bool bdb_bulkloadpair(BULKLOAD *load, VALUE vkey, VALUE vval){
+  TCBDB *bdb;
+  TCCMP cmp;
+  VALBUF key, val;
+  int lsiz;
+  bdb = load->data->bdb;
+  vkeytobuf(vkey, load->data->kcodec, &key);
+  StringValueBuf(vval, &val);
+  lsiz = RSTRING_LEN(load->vlast);
+  if(load->cnt > 0){
+    cmp = bdb->cmp ? bdb->cmp : tccmplexical;
+    if(cmp(RSTRING_PTR(load->vlast), lsiz, key.ptr, key.size, bdb->cmpop) > 0) load->ucnt++;
+  }
+  if(load->dup){
+    if(!tcbdbputdup(bdb, key.ptr, key.size, val.ptr, val.size)) return false;
+  } else {
+    if(!tcbdbput(bdb, key.ptr, key.size, val.ptr, val.size)) return false;
+  }
+  if(key.size > lsiz) rb_str_resize(load->vlast, key.size);
+  memcpy(RSTRING_PTR(load->vlast), key.ptr, key.size);
+  vstrsetlen(load->vlast, key.size);
+  load->cnt++;
+  return true;
+}
+
+
+static VALUE bdb_bulkloadrec(RB_BLOCK_CALL_FUNC_ARGLIST(vrec, vload)){
+  BULKLOAD *load;
+  load = (BULKLOAD *)vload;
+  if(argc < 2){
+    Check_Type(vrec, T_ARRAY);
+    if(RARRAY_LEN(vrec) != 2) rb_raise(rb_eArgError, "wrong record size (expected a pair)");
+    load->ok = bdb_bulkloadpair(load, rb_ary_entry(vrec, 0), rb_ary_entry(vrec, 1));
+  } else {
+    load->ok = bdb_bulkloadpair(load, argv[0], argv[1]);
+  }
+  if(!load->ok) rb_iter_break();
+  return Qnil;
+}
+
+
+static VALUE bdb_bulkloadbody(VALUE vload){
+  VALUE vrec;
+  BULKLOAD *load;
+  int i, num;
+  load = (BULKLOAD *)vload;
+  if(TYPE(load->vrecs) == T_ARRAY){
+    num = RARRAY_LEN(load->vrecs);
+    for(i = 0; i < num && load->ok; i++){
+      vrec = rb_ary_entry(load->vrecs, i);
+      Check_Type(vrec, T_ARRAY);
+      if(RARRAY_LEN(vrec) != 2) rb_raise(rb_eArgError, "wrong record size (expected a pair)");
+      load->ok = bdb_bulkloadpair(load, rb_ary_entry(vrec, 0), rb_ary_entry(vrec, 1));
+    }
+  } else {
+    rb_block_call(load->vrecs, rb_intern("each"), 0, NULL, bdb_bulkloadrec, (VALUE)load);
+  }
+  return Qnil;
+}
+
+
+static VALUE bdb_bulk_load(RBVARARGS){
+  VALUE vrecs, vopts;
+  BULKLOAD load;
+  TCBDB *bdb;
+  int state;
+  bool tran;
+  rb_scan_args(argc, argv, "11", &vrecs, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetBDBDATA(vself, load.data);
+  bdb = load.data->bdb;
+  load.vrecs = vrecs;
+  load.dup = vhashopt(vopts, "dup") == Qtrue;
+  load.vlast = rb_str_new(NULL, 0);
+  load.cnt = 0;
+  load.ucnt = 0;
+  load.ok = true;
+  if(tran && !tcbdbtranbegin(bdb)) return Qnil;
+  state = 0;
+  rb_protect(bdb_bulkloadbody, (VALUE)&load, &state);
+  if(state){
+    if(tran) tcbdbtranabort(bdb);
+    rb_jump_tag(state);
+  }
+  if(!load.ok){
+    if(tran) tcbdbtranabort(bdb);
+    return Qnil;
+  }
+  if(tran && !tcbdbtrancommit(bdb)){
+    tcbdbtranabort(bdb);
+    return Qnil;
+  }
+  return rb_assoc_new(LL2NUM(load.cnt), LL2NUM(load.ucnt));
+}
+
+
+static VALUE bdb_out(RBSELF, VALUE vkey){
+  BDBDATA *data;
+  TCBDB *bdb;
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  return tcbdbout(bdb, key.ptr, key.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE bdb_outlist(RBSELF, VALUE vkey){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbout(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  return tcbdbout3(bdb, key.ptr, key.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_outlist(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_mout(RBVARARGS){
+  VALUE vkeys, vopts, vkey, vmiss;
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbout3(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  int i, num, cnt;
+  bool tran, dup, err;
+  rb_scan_args(argc, argv, "11", &vkeys, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  dup = vhashopt(vopts, "dup") == Qtrue;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeys = vkeystoary(vkeys, data->kcodec);
+  if(tran && !tcbdbtranbegin(bdb)) return Qnil;
+  vmiss = rb_ary_new();
+  cnt = 0;
+  err = false;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    vkeytobuf(vkey, data->kcodec, &key);
+    if(dup ? tcbdbout3(bdb, key.ptr, key.size) : tcbdbout(bdb, key.ptr, key.size)){
+      cnt++;
+    } else if(tcbdbecode(bdb) == TCENOREC){
+      rb_ary_push(vmiss, vkey);
+    } else {
+      err = true;
+      break;
+    }
+  }
+  if(err){
+    if(tran) tcbdbtranabort(bdb);
+    return Qnil;
+  }
+  if(tran && !tcbdbtrancommit(bdb)){
+    tcbdbtranabort(bdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vmiss);
 }
 
 
-static VALUE bdb_get(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_get(RBSELF, VALUE vkey){
+  BDBDATA *data;
   TCBDB *bdb;
+  VALBUF key;
   const char *vbuf;
   int vsiz;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  if(!(vbuf = tcbdbget3(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz))) return Qnil;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  if(!(vbuf = tcbdbget3(bdb, key.ptr, key.size, &vsiz))) return Qnil;
   return rb_str_new(vbuf, vsiz);
 }
 
 
-static VALUE bdb_getlist(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb, vary;
+static VALUE bdb_mget(RBSELF, VALUE vkeys){
+  VALUE vkey, vhash;
+  BDBDATA *data;
+  TCBDB *bdb;
+  VALBUF key;
+  const char *vbuf;
+  int i, num, vsiz;
+  Check_Type(vkeys, T_ARRAY);
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    vkeytobuf(vkey, data->kcodec, &key);
+    if((vbuf = tcbdbget3(bdb, key.ptr, key.size, &vsiz)) != NULL)
+      rb_hash_aset(vhash, vkey, rb_str_new(vbuf, vsiz));
+  }
+  return vhash;
+}
+
+
+static VALUE bdb_get_into(RBSELF, VALUE vkey, VALUE vbuf){
+  BDBDATA *data;
+  VALBUF key;
+  const char *vptr;
+  char *buf;
+  int max, vsiz;
+  if(vbuf == vkey) rb_raise(rb_eArgError, "the buffer must not be the key");
+  GetBDBDATA(vself, data);
+  vkeytobuf(vkey, data->kcodec, &key);
+  if(!(vptr = tcbdbget3(data->bdb, key.ptr, key.size, &vsiz))) return Qnil;
+  buf = vstrreserve(vbuf, vsiz, &max);
+  memcpy(buf, vptr, vsiz);
+  vstrsetlen(vbuf, vsiz);
+  return vbuf;
+}
+
+
+static VALUE bdb_getlist(RBSELF, VALUE vkey){
+  VALUE vary;
+  BDBDATA *data;
   TCBDB *bdb;
   TCLIST *vals;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  if(!(vals = tcbdbget4(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)))) return Qnil;
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  if(!(vals = tcbdbget4(bdb, key.ptr, key.size))) return Qnil;
   vary = listtovary(vals);
   tclistdel(vals);
   return vary;
 }
 
 
-static VALUE bdb_vnum(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_vnum(RBSELF, VALUE vkey){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return INT2NUM(tcbdbvnum(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)));
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  return INT2NUM(tcbdbvnum(bdb, key.ptr, key.size));
 }
 
 
-static VALUE bdb_vsiz(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_vsiz(RBSELF, VALUE vkey){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return INT2NUM(tcbdbvsiz(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)));
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  return INT2NUM(tcbdbvsiz(bdb, key.ptr, key.size));
 }
 
 
-static VALUE bdb_range(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vbkey, vbinc, vekey, veinc, vmax, vary;
+static VALUE bdb_range(RBVARARGS){
+  VALUE vbkey, vbinc, vekey, veinc, vmax, vopts, vary;
+  BDBDATA *data;
   TCBDB *bdb;
   TCLIST *keys;
-  const char *bkbuf, *ekbuf;
-  int bksiz, eksiz, max;
+  VALBUF bkey, ekey;
+  BLOCKCALL call;
+  int max;
   bool binc, einc;
-  rb_scan_args(argc, argv, "05", &vbkey, &vbinc, &vekey, &veinc, &vmax);
-  if(vbkey != Qnil) vbkey = StringValueEx(vbkey);
-  if(vekey != Qnil) vekey = StringValueEx(vekey);
-  binc = (vbinc != Qnil && vbinc != Qfalse);
-  einc = (veinc != Qnil && veinc != Qfalse);
-  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  rb_scan_args(argc, argv, "06", &vbkey, &vbinc, &vekey, &veinc, &vmax, &vopts);
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
   if(vbkey != Qnil){
-    bkbuf = RSTRING_PTR(vbkey);
-    bksiz = RSTRING_LEN(vbkey);
+    vkeytobuf(vbkey, data->kcodec, &bkey);
   } else {
-    bkbuf = NULL;
-    bksiz = -1;
+    bkey.vstr = Qnil;
+    bkey.ptr = NULL;
+    bkey.size = -1;
   }
   if(vekey != Qnil){
-    ekbuf = RSTRING_PTR(vekey);
-    eksiz = RSTRING_LEN(vekey);
+    vkeytobuf(vekey, data->kcodec, &ekey);
   } else {
-    ekbuf = NULL;
-    eksiz = -1;
+    ekey.vstr = Qnil;
+    ekey.ptr = NULL;
+    ekey.size = -1;
   }
-  keys = tcbdbrange(bdb, bkbuf, bksiz, binc, ekbuf, eksiz, einc, max);
-  vary = listtovary(keys);
+  binc = (vbinc != Qnil && vbinc != Qfalse);
+  einc = (veinc != Qnil && veinc != Qfalse);
+  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
+  if(vhashopt(vopts, "reverse") == Qtrue)
+    return bdbrangeback(data, vbkey != Qnil ? &bkey : NULL, binc, vekey != Qnil ? &ekey : NULL, einc, max);
+  call.obj = bdb;
+  call.kbuf = bkey.ptr;
+  call.ksiz = bkey.size;
+  call.vbuf = ekey.ptr;
+  call.vsiz = ekey.size;
+  call.nums[0] = binc;
+  call.nums[1] = einc;
+  call.nums[2] = max;
+  if(bdb->cmp == (TCCMP)bdb_cmpobj){
+    bdbrange_blocking(&call);
+  } else {
+    callblocking(bdbrange_blocking, &call, bkey.vstr, ekey.vstr);
+  }
+  keys = call.rv;
+  vary = listtovkeys(keys, data->kcodec);
   tclistdel(keys);
   return vary;
 }
 
 
-static VALUE bdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vprefix, vmax, vary;
+static VALUE bdb_fwmkeys(RBVARARGS){
+  VALUE vprefix, vmax, vary;
+  BDBDATA *data;
   TCBDB *bdb;
   TCLIST *keys;
+  VALBUF prefix;
   int max;
   rb_scan_args(argc, argv, "11", &vprefix, &vmax);
-  vprefix = StringValueEx(vprefix);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  StringValueBuf(vprefix, &prefix);
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  keys = tcbdbfwmkeys(bdb, RSTRING_PTR(vprefix), RSTRING_LEN(vprefix), max);
-  vary = listtovary(keys);
+  keys = tcbdbfwmkeys(bdb, prefix.ptr, prefix.size, max);
+  vary = listtovkeys(keys, data->kcodec);
   tclistdel(keys);
   return vary;
 }
 
 
-static VALUE bdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vbdb;
+static VALUE bdb_addint(RBSELF, VALUE vkey, VALUE vnum){
+  BDBDATA *data;
   TCBDB *bdb;
+  VALBUF key;
   int num;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  num = tcbdbaddint(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2INT(vnum));
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  num = tcbdbaddint(bdb, key.ptr, key.size, NUM2INT(vnum));
   return num == INT_MIN ? Qnil : INT2NUM(num);
 }
 
 
-static VALUE bdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vbdb;
+static VALUE bdb_adddouble(RBSELF, VALUE vkey, VALUE vnum){
+  BDBDATA *data;
   TCBDB *bdb;
+  VALBUF key;
   double num;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  num = tcbdbadddouble(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2DBL(vnum));
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  num = tcbdbadddouble(bdb, key.ptr, key.size, NUM2DBL(vnum));
   return isnan(num) ? Qnil : rb_float_new(num);
 }
 
 
-static VALUE bdb_sync(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_sync(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbsync(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vlmemb, vnmemb, vbnum, vapow, vfpow, vopts;
+static VALUE bdb_optimize(RBVARARGS){
+  VALUE vlmemb, vnmemb, vbnum, vapow, vfpow, vopts;
   TCBDB *bdb;
   int lmemb, nmemb, apow, fpow, opts;
   int64_t bnum;
@@ -1523,97 +3186,82 @@ static VALUE bdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? UINT8_MAX : NUM2INT(vopts);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdboptimize(bdb, lmemb, nmemb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_vanish(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_vanish(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbvanish(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_copy(VALUE vself, SEL sel, VALUE vpath){
-  VALUE vbdb;
+static VALUE bdb_copy(RBSELF, VALUE vpath){
   TCBDB *bdb;
   Check_Type(vpath, T_STRING);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbcopy(bdb, RSTRING_PTR(vpath)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_tranbegin(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_tranbegin(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbtranbegin(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_trancommit(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_trancommit(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbtrancommit(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_tranabort(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_tranabort(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbtranabort(bdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_path(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_path(RBSELF){
   TCBDB *bdb;
   const char *path;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   if(!(path = tcbdbpath(bdb))) return Qnil;
   return rb_str_new2(path);
 }
 
 
-static VALUE bdb_rnum(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_rnum(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return LL2NUM(tcbdbrnum(bdb));
 }
 
 
-static VALUE bdb_fsiz(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_fsiz(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return LL2NUM(tcbdbfsiz(bdb));
 }
 
 
-static VALUE bdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vbdb, vkey, vdef, vval;
+static VALUE bdb_fetch(RBVARARGS){
+  VALUE vkey, vdef, vval;
+  BDBDATA *data;
   TCBDB *bdb;
+  VALBUF key;
   char *vbuf;
   int vsiz;
   rb_scan_args(argc, argv, "11", &vkey, &vdef);
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  if((vbuf = tcbdbget(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz)) != NULL){
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  if((vbuf = tcbdbget(bdb, key.ptr, key.size, &vsiz)) != NULL){
     vval = rb_str_new(vbuf, vsiz);
     tcfree(vbuf);
   } else {
@@ -1623,31 +3271,31 @@ static VALUE bdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE bdb_check(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vbdb;
+static VALUE bdb_check(RBSELF, VALUE vkey){
+  BDBDATA *data;
   TCBDB *bdb;
-  vkey = StringValueEx(vkey);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  return tcbdbvsiz(bdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) >= 0 ? Qtrue : Qfalse;
+  VALBUF key;
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
+  vkeytobuf(vkey, data->kcodec, &key);
+  return tcbdbvsiz(bdb, key.ptr, key.size) >= 0 ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_check_value(VALUE vself, SEL sel, VALUE vval){
-  VALUE vbdb;
+static VALUE bdb_check_value(RBSELF, VALUE vval){
   TCBDB *bdb;
   BDBCUR *cur;
+  VALBUF val;
   const char *tvbuf;
   bool hit;
   int tvsiz;
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  StringValueBuf(vval, &val);
+  GetBDB(vself, bdb);
   hit = false;
   cur = tcbdbcurnew(bdb);
   tcbdbcurfirst(cur);
   while((tvbuf = tcbdbcurval3(cur, &tvsiz)) != NULL){
-    if(tvsiz == RSTRING_LEN(vval) && memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvsiz == val.size && memcmp(tvbuf, val.ptr, val.size) == 0){
       hit = true;
       break;
     }
@@ -1658,22 +3306,24 @@ static VALUE bdb_check_value(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE bdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
-  VALUE vbdb, vrv;
+static VALUE bdb_get_reverse(RBSELF, VALUE vval){
+  VALUE vrv;
+  BDBDATA *data;
   TCBDB *bdb;
   BDBCUR *cur;
+  VALBUF val;
   const char *tvbuf, *tkbuf;
   int tvsiz, tksiz;
-  vval = StringValueEx(vval);
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  StringValueBuf(vval, &val);
+  GetBDBDATA(vself, data);
+  bdb = data->bdb;
   vrv = Qnil;
   cur = tcbdbcurnew(bdb);
   tcbdbcurfirst(cur);
   while((tvbuf = tcbdbcurval3(cur, &tvsiz)) != NULL){
-    if(tvsiz == RSTRING_LEN(vval) && memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvsiz == val.size && memcmp(tvbuf, val.ptr, val.size) == 0){
       if((tkbuf = tcbdbcurkey3(cur, &tksiz)) != NULL)
-        vrv = rb_str_new(tkbuf, tksiz);
+        vrv = buftovkey(tkbuf, tksiz, data->kcodec);
       break;
     }
     tcbdbcurnext(cur);
@@ -1683,125 +3333,326 @@ static VALUE bdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE bdb_empty(VALUE vself, SEL sel){
-  VALUE vbdb;
+static VALUE bdb_empty(RBSELF){
   TCBDB *bdb;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
+  GetBDB(vself, bdb);
   return tcbdbrnum(bdb) < 1 ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdb_each(VALUE vself, SEL sel){
-  VALUE vbdb, vrv;
+static void bdbiterstart(ITERDATA *iter){
   TCBDB *bdb;
-  BDBCUR *cur;
-  TCXSTR *kxstr, *vxstr;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  vrv = Qnil;
-  kxstr = tcxstrnew();
-  vxstr = tcxstrnew();
-  cur = tcbdbcurnew(bdb);
-  tcbdbcurfirst(cur);
-  while(tcbdbcurrec(cur, kxstr, vxstr)){
-    vrv = rb_yield_values(2, rb_str_new(tcxstrptr(kxstr), tcxstrsize(kxstr)),
-                          rb_str_new(tcxstrptr(vxstr), tcxstrsize(vxstr)));
-    tcbdbcurnext(cur);
+  TCCMP cmp;
+  const char *kbuf;
+  int ksiz;
+  bdb = iter->obj;
+  cmp = bdb->cmp ? bdb->cmp : tccmplexical;
+  if(iter->reverse){
+    if(!iter->ekbuf){
+      tcbdbcurlast(iter->cur);
+      return;
+    }
+    tcbdbcurjumpback(iter->cur, iter->ekbuf, iter->eksiz);
+    if(iter->einc) return;
+    while((kbuf = tcbdbcurkey3(iter->cur, &ksiz)) != NULL &&
+          cmp(kbuf, ksiz, iter->ekbuf, iter->eksiz, bdb->cmpop) >= 0){
+      tcbdbcurprev(iter->cur);
+    }
+  } else {
+    if(!iter->bkbuf){
+      tcbdbcurfirst(iter->cur);
+      return;
+    }
+    tcbdbcurjump(iter->cur, iter->bkbuf, iter->bksiz);
+    if(iter->binc) return;
+    while((kbuf = tcbdbcurkey3(iter->cur, &ksiz)) != NULL &&
+          cmp(kbuf, ksiz, iter->bkbuf, iter->bksiz, bdb->cmpop) <= 0){
+      tcbdbcurnext(iter->cur);
+    }
   }
-  tcbdbcurdel(cur);
-  tcxstrdel(vxstr);
-  tcxstrdel(kxstr);
-  return vrv;
 }
 
 
-static VALUE bdb_each_key(VALUE vself, SEL sel){
-  VALUE vbdb, vrv;
+static bool bdbiterinrange(ITERDATA *iter, const char *kbuf, int ksiz){
   TCBDB *bdb;
-  BDBCUR *cur;
+  TCCMP cmp;
+  int rv;
+  bdb = iter->obj;
+  cmp = bdb->cmp ? bdb->cmp : tccmplexical;
+  if(iter->reverse){
+    rv = cmp(kbuf, ksiz, iter->bkbuf, iter->bksiz, bdb->cmpop);
+    return iter->binc ? rv >= 0 : rv > 0;
+  }
+  rv = cmp(kbuf, ksiz, iter->ekbuf, iter->eksiz, bdb->cmpop);
+  return iter->einc ? rv <= 0 : rv < 0;
+}
+
+
+static void bdbiterseek(ITERDATA *iter){
+  const char *lbuf, *kbuf;
+  int lsiz, ksiz;
+  lbuf = tcxstrptr(iter->lxstr);
+  lsiz = tcxstrsize(iter->lxstr);
+  if(iter->reverse ? !tcbdbcurjumpback(iter->cur, lbuf, lsiz) : !tcbdbcurjump(iter->cur, lbuf, lsiz))
+    return;
+  while((kbuf = tcbdbcurkey3(iter->cur, &ksiz)) != NULL && ksiz == lsiz && !memcmp(kbuf, lbuf, lsiz)){
+    if(iter->reverse){
+      tcbdbcurprev(iter->cur);
+    } else {
+      tcbdbcurnext(iter->cur);
+    }
+  }
+}
+
+
+static int bdbiterfill(ITERDATA *iter, int max){
+  const char *kbuf, *vbuf;
+  int ksiz, vsiz, num;
+  bool bound;
+  tclistclear(iter->recs);
+  bound = iter->reverse ? iter->bkbuf != NULL : iter->ekbuf != NULL;
+  num = 0;
+  while(max < 0 || num < max){
+    if(!(kbuf = tcbdbcurkey3(iter->cur, &ksiz))) break;
+    if(bound && !bdbiterinrange(iter, kbuf, ksiz)) break;
+    if(num < 1 || ksiz != tcxstrsize(iter->lxstr) || memcmp(kbuf, tcxstrptr(iter->lxstr), ksiz)){
+      if(num >= BDBITERUNIT) break;
+      tcxstrclear(iter->lxstr);
+      tcxstrcat(iter->lxstr, kbuf, ksiz);
+    }
+    if(iter->mode == IMKEY){
+      vbuf = "";
+      vsiz = 0;
+    } else if(!(vbuf = tcbdbcurval3(iter->cur, &vsiz))){
+      break;
+    }
+    tclistpush(iter->recs, kbuf, ksiz);
+    tclistpush(iter->recs, vbuf, vsiz);
+    num++;
+    if(iter->reverse){
+      tcbdbcurprev(iter->cur);
+    } else {
+      tcbdbcurnext(iter->cur);
+    }
+  }
+  return num;
+}
+
+
+static VALUE bdb_iterate(VALUE viter){
+  ITERDATA *iter;
+  const char *kbuf, *vbuf;
+  int i, ksiz, vsiz, num, cnt;
+  iter = (ITERDATA *)viter;
+  iter->recs = tclistnew();
+  iter->lxstr = tcxstrnew();
+  bdbiterstart(iter);
+  cnt = 0;
+  while(iter->max < 0 || cnt < iter->max){
+    if(cnt > 0) bdbiterseek(iter);
+    if(bdbiterfill(iter, iter->max < 0 ? -1 : iter->max - cnt) < 1) break;
+    num = tclistnum(iter->recs);
+    for(i = 0; i < num; i += 2){
+      kbuf = tclistval(iter->recs, i, &ksiz);
+      vbuf = tclistval(iter->recs, i + 1, &vsiz);
+      iteryield(iter, kbuf, ksiz, vbuf, vsiz);
+      cnt++;
+    }
+  }
+  return iterfinish(iter);
+}
+
+
+static VALUE bdbrangeback(BDBDATA *data, VALBUF *bkey, bool binc, VALBUF *ekey, bool einc, int max){
+  VALUE vary;
+  ITERDATA iter;
   const char *kbuf;
   int ksiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  vrv = Qnil;
-  cur = tcbdbcurnew(bdb);
-  tcbdbcurfirst(cur);
-  while((kbuf = tcbdbcurkey3(cur, &ksiz)) != NULL){
-    vrv = rb_yield(rb_str_new(kbuf, ksiz));
-    tcbdbcurnext(cur);
+  iterinit(&iter, data->bdb, IMKEY, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  iter.reverse = true;
+  iter.max = max;
+  if(bkey){
+    iter.bkbuf = tcmemdup(bkey->ptr, bkey->size);
+    iter.bksiz = bkey->size;
   }
-  tcbdbcurdel(cur);
-  return vrv;
+  if(ekey){
+    iter.ekbuf = tcmemdup(ekey->ptr, ekey->size);
+    iter.eksiz = ekey->size;
+  }
+  iter.binc = binc;
+  iter.einc = einc;
+  vary = rb_ary_new();
+  bdbiterstart(&iter);
+  while((iter.max < 0 || RARRAY_LEN(vary) < iter.max) &&
+        (kbuf = tcbdbcurkey3(iter.cur, &ksiz)) != NULL){
+    if(iter.bkbuf && !bdbiterinrange(&iter, kbuf, ksiz)) break;
+    rb_ary_push(vary, buftovkey(kbuf, ksiz, iter.kcodec));
+    tcbdbcurprev(iter.cur);
+  }
+  iterfree((VALUE)&iter);
+  return vary;
 }
 
 
-static VALUE bdb_each_value(VALUE vself, SEL sel){
-  VALUE vbdb, vrv;
-  TCBDB *bdb;
-  BDBCUR *cur;
-  const char *vbuf;
-  int vsiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  vrv = Qnil;
-  cur = tcbdbcurnew(bdb);
-  tcbdbcurfirst(cur);
-  while((vbuf = tcbdbcurval3(cur, &vsiz)) != NULL){
-    vrv = rb_yield(rb_str_new(vbuf, vsiz));
-    tcbdbcurnext(cur);
+static VALUE bdb_each(RBVARARGS){
+  VALUE vopts;
+  BDBDATA *data;
+  ITERDATA iter;
+  bool view;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each", argc, argv, true);
+  GetBDBDATA(vself, data);
+  view = vhashopt(vopts, "view") == Qtrue;
+  iterinit(&iter, data->bdb, IMPAIR, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  iter.view = view;
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_each_batch(RBSELF, VALUE vnum){
+  BDBDATA *data;
+  ITERDATA iter;
+  int num;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  GetBDBDATA(vself, data);
+  iterinit(&iter, data->bdb, IMBATCH, num, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_each_range(RBVARARGS){
+  VALUE vbkey, vbinc, vekey, veinc, vopts, vmax;
+  BDBDATA *data;
+  ITERDATA iter;
+  VALBUF bkey, ekey;
+  bool view, reverse;
+  int nargc, max;
+  nargc = argc;
+  vopts = Qnil;
+  if(nargc > 0 && TYPE(argv[nargc-1]) == T_HASH) vopts = argv[--nargc];
+  rb_scan_args(nargc, argv, "04", &vbkey, &vbinc, &vekey, &veinc);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_range", argc, argv, false);
+  GetBDBDATA(vself, data);
+  if(vbkey != Qnil) vkeytobuf(vbkey, data->kcodec, &bkey);
+  if(vekey != Qnil) vkeytobuf(vekey, data->kcodec, &ekey);
+  vmax = vhashopt(vopts, "limit");
+  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
+  view = vhashopt(vopts, "view") == Qtrue;
+  reverse = vhashopt(vopts, "reverse") == Qtrue;
+  iterinit(&iter, data->bdb, IMPAIR, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  iter.view = view;
+  iter.reverse = reverse;
+  iter.max = max;
+  if(vbkey != Qnil){
+    iter.bkbuf = tcmemdup(bkey.ptr, bkey.size);
+    iter.bksiz = bkey.size;
   }
-  tcbdbcurdel(cur);
-  return vrv;
+  if(vekey != Qnil){
+    iter.ekbuf = tcmemdup(ekey.ptr, ekey.size);
+    iter.eksiz = ekey.size;
+  }
+  iter.binc = (vbinc != Qnil && vbinc != Qfalse);
+  iter.einc = (veinc != Qnil && veinc != Qfalse);
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_each_reverse(RBVARARGS){
+  VALUE vopts, vmax;
+  BDBDATA *data;
+  ITERDATA iter;
+  bool view;
+  int max;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_reverse", argc, argv, false);
+  GetBDBDATA(vself, data);
+  vmax = vhashopt(vopts, "limit");
+  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
+  view = vhashopt(vopts, "view") == Qtrue;
+  iterinit(&iter, data->bdb, IMPAIR, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  iter.view = view;
+  iter.reverse = true;
+  iter.max = max;
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_each_key(RBSELF){
+  BDBDATA *data;
+  ITERDATA iter;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_key", 0, NULL, true);
+  GetBDBDATA(vself, data);
+  iterinit(&iter, data->bdb, IMKEY, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_each_value(RBVARARGS){
+  VALUE vopts;
+  BDBDATA *data;
+  ITERDATA iter;
+  bool view;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_value", argc, argv, true);
+  GetBDBDATA(vself, data);
+  view = vhashopt(vopts, "view") == Qtrue;
+  iterinit(&iter, data->bdb, IMVALUE, 0, data->kcodec);
+  iter.cur = tcbdbcurnew(data->bdb);
+  iter.view = view;
+  return rb_ensure(bdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdb_keys(RBSELF){
+  return vnewenum(vself, "each_key", 0, NULL, true);
 }
 
 
-static VALUE bdb_keys(VALUE vself, SEL sel){
-  VALUE vbdb, vary;
-  TCBDB *bdb;
-  BDBCUR *cur;
-  const char *kbuf;
-  int ksiz;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  vary = rb_ary_new2(tcbdbrnum(bdb));
-  cur = tcbdbcurnew(bdb);
-  tcbdbcurfirst(cur);
-  while((kbuf = tcbdbcurkey3(cur, &ksiz)) != NULL){
-    rb_ary_push(vary, rb_str_new(kbuf, ksiz));
-    tcbdbcurnext(cur);
+static VALUE bdb_values(RBSELF){
+  return vnewenum(vself, "each_value", 0, NULL, true);
+}
+
+
+static VALUE bdb_kcodec(RBSELF){
+  BDBDATA *data;
+  GetBDBDATA(vself, data);
+  switch(data->kcodec){
+  case KCINT32: return ID2SYM(rb_intern("int32"));
+  case KCINT64: return ID2SYM(rb_intern("int64"));
   }
-  tcbdbcurdel(cur);
-  return vary;
+  return Qnil;
 }
 
 
-static VALUE bdb_values(VALUE vself, SEL sel){
-  VALUE vbdb, vary;
-  TCBDB *bdb;
-  BDBCUR *cur;
-  const char *vbuf;
-  int vsiz;
-  vbdb = rb_iv_get(vself, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  vary = rb_ary_new2(tcbdbrnum(bdb));
-  cur = tcbdbcurnew(bdb);
-  tcbdbcurfirst(cur);
-  while((vbuf = tcbdbcurval3(cur, &vsiz)) != NULL){
-    rb_ary_push(vary, rb_str_new(vbuf, vsiz));
-    tcbdbcurnext(cur);
+static VALUE bdb_setkcodec(RBSELF, VALUE vcodec){
+  BDBDATA *data;
+  int kcodec;
+  if(vcodec == Qnil){
+    kcodec = KCSTRING;
+  } else if(vcodec == ID2SYM(rb_intern("int32"))){
+    kcodec = KCINT32;
+  } else if(vcodec == ID2SYM(rb_intern("int64"))){
+    kcodec = KCINT64;
+  } else {
+    rb_raise(rb_eArgError, "unknown key codec");
   }
-  tcbdbcurdel(cur);
-  return vary;
+  GetBDBDATA(vself, data);
+  data->kcodec = kcodec;
+  return vcodec;
 }
 
 
 static void bdbcur_init(void){
   cls_bdbcur = rb_define_class_under(mod_tokyocabinet, "BDBCUR", rb_cObject);
-  cls_bdbcur_data = rb_define_class_under(mod_tokyocabinet, "BDBCUR_data", rb_cObject);
+  rb_define_alloc_func(cls_bdbcur, bdbcur_alloc);
   rb_define_const(cls_bdbcur, "CPCURRENT", INT2NUM(BDBCPCURRENT));
   rb_define_const(cls_bdbcur, "CPBEFORE", INT2NUM(BDBCPBEFORE));
   rb_define_const(cls_bdbcur, "CPAFTER", INT2NUM(BDBCPAFTER));
@@ -1815,113 +3666,114 @@ static void bdbcur_init(void){
   rb_define_method(cls_bdbcur, "out", bdbcur_out, 0);
   rb_define_method(cls_bdbcur, "key", bdbcur_key, 0);
   rb_define_method(cls_bdbcur, "val", bdbcur_val, 0);
+  rb_define_method(cls_bdbcur, "next_n", bdbcur_next_n, 1);
+  rb_define_method(cls_bdbcur, "prev_n", bdbcur_prev_n, 1);
 }
 
 
-static VALUE bdbcur_initialize(VALUE vself, SEL sel, VALUE vbdb){
-  VALUE vcur;
-  TCBDB *bdb;
-  BDBCUR *cur;
-  Check_Type(vbdb, T_OBJECT);
-  vbdb = rb_iv_get(vbdb, BDBVNDATA);
-  Data_Get_Struct(vbdb, TCBDB, bdb);
-  cur = tcbdbcurnew(bdb);
-  vcur = Data_Wrap_Struct(cls_bdbcur_data, 0, tcbdbcurdel, cur);
-  rb_iv_set(vself, BDBCURVNDATA, vcur);
+static void bdbcur_free(BDBCURDATA *data){
+  if(data->cur) tcbdbcurdel(data->cur);
+  tcfree(data);
+}
+
+
+static VALUE bdbcur_alloc(VALUE klass){
+  BDBCURDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->cur = NULL;
+  data->bdata = NULL;
+  return WrapDATA(klass, &bdbcur_type, data);
+}
+
+
+static VALUE bdbcur_initialize(RBSELF, VALUE vbdb){
+  BDBCURDATA *data;
+  BDBDATA *bdata;
+  if(rb_obj_is_kind_of(vbdb, cls_bdb) != Qtrue)
+    rb_raise(rb_eTypeError, "wrong argument type %s (expected BDB)", rb_obj_classname(vbdb));
+  GetBDBDATA(vbdb, bdata);
+  GetDATA(vself, BDBCURDATA, &bdbcur_type, data);
+  if(data->cur) tcbdbcurdel(data->cur);
+  data->cur = tcbdbcurnew(bdata->bdb);
+  data->bdata = bdata;
   rb_iv_set(vself, BDBVNDATA, vbdb);
   return Qnil;
 }
 
 
-static VALUE bdbcur_first(VALUE vself, SEL sel){
-  VALUE vcur;
+static VALUE bdbcur_first(RBSELF){
   BDBCUR *cur;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   return tcbdbcurfirst(cur) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_last(VALUE vself, SEL sel){
-  VALUE vcur;
+static VALUE bdbcur_last(RBSELF){
   BDBCUR *cur;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   return tcbdbcurlast(cur) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_jump(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vcur;
-  BDBCUR *cur;
-  vkey = StringValueEx(vkey);
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
-  return tcbdbcurjump(cur, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+static VALUE bdbcur_jump(RBSELF, VALUE vkey){
+  BDBCURDATA *data;
+  VALBUF key;
+  GetBDBCURDATA(vself, data);
+  vkeytobuf(vkey, data->bdata->kcodec, &key);
+  return tcbdbcurjump(data->cur, key.ptr, key.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_prev(VALUE vself, SEL sel){
-  VALUE vcur;
+static VALUE bdbcur_prev(RBSELF){
   BDBCUR *cur;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   return tcbdbcurprev(cur) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_next(VALUE vself, SEL sel){
-  VALUE vcur;
+static VALUE bdbcur_next(RBSELF){
   BDBCUR *cur;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   return tcbdbcurnext(cur) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_put(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vcur, vval, vcpmode;
+static VALUE bdbcur_put(RBVARARGS){
+  VALUE vval, vcpmode;
   BDBCUR *cur;
+  VALBUF val;
   int cpmode;
   rb_scan_args(argc, argv, "11", &vval, &vcpmode);
-  vval = StringValueEx(vval);
+  StringValueBuf(vval, &val);
   cpmode = (vcpmode == Qnil) ? BDBCPCURRENT : NUM2INT(vcpmode);
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
-  return tcbdbcurput(cur, RSTRING_PTR(vval), RSTRING_LEN(vval), cpmode) ? Qtrue : Qfalse;
+  GetBDBCUR(vself, cur);
+  return tcbdbcurput(cur, val.ptr, val.size, cpmode) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_out(VALUE vself, SEL sel){
-  VALUE vcur;
+static VALUE bdbcur_out(RBSELF){
   BDBCUR *cur;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   return tcbdbcurout(cur) ? Qtrue : Qfalse;
 }
 
 
-static VALUE bdbcur_key(VALUE vself, SEL sel){
-  VALUE vcur, vkey;
-  BDBCUR *cur;
-  char *kbuf;
+static VALUE bdbcur_key(RBSELF){
+  BDBCURDATA *data;
+  const char *kbuf;
   int ksiz;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
-  if(!(kbuf = tcbdbcurkey(cur, &ksiz))) return Qnil;
-  vkey = rb_str_new(kbuf, ksiz);
-  tcfree(kbuf);
-  return vkey;
+  GetBDBCURDATA(vself, data);
+  if(!(kbuf = tcbdbcurkey3(data->cur, &ksiz))) return Qnil;
+  return buftovkey(kbuf, ksiz, data->bdata->kcodec);
 }
 
 
-static VALUE bdbcur_val(VALUE vself, SEL sel){
-  VALUE vcur, vval;
+static VALUE bdbcur_val(RBSELF){
+  VALUE vval;
   BDBCUR *cur;
   char *vbuf;
   int vsiz;
-  vcur = rb_iv_get(vself, BDBCURVNDATA);
-  Data_Get_Struct(vcur, BDBCUR, cur);
+  GetBDBCUR(vself, cur);
   if(!(vbuf = tcbdbcurval(cur, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
@@ -1929,9 +3781,52 @@ static VALUE bdbcur_val(VALUE vself, SEL sel){
 }
 
 
+static VALUE bdbcur_next_n(RBSELF, VALUE vnum){
+  return bdbcurrecs(vself, vnum, false);
+}
+
+
+static VALUE bdbcur_prev_n(RBSELF, VALUE vnum){
+  return bdbcurrecs(vself, vnum, true);
+}
+
+
+static VALUE bdbcurrecs(VALUE vself, VALUE vnum, bool back){
+  BDBCURDATA *data;
+  ITERDATA iter;
+  int num;
+  num = NUM2INT(vnum);
+  if(num < 0) rb_raise(rb_eArgError, "number of records must not be negative");
+  GetBDBCURDATA(vself, data);
+  iterinit(&iter, data->cur, IMBATCH, num, data->bdata->kcodec);
+  iter.reverse = back;
+  return rb_ensure(bdbcurfill, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE bdbcurfill(VALUE viter){
+  ITERDATA *iter;
+  BDBCUR *cur;
+  int i;
+  iter = (ITERDATA *)viter;
+  cur = iter->obj;
+  for(i = 0; i < iter->num && tcbdbcurrec(cur, iter->kxstr, iter->vxstr); i++){
+    rb_ary_push(iter->vrecs,
+                rb_assoc_new(buftovkey(tcxstrptr(iter->kxstr), tcxstrsize(iter->kxstr), iter->kcodec),
+                             rb_str_new(tcxstrptr(iter->vxstr), tcxstrsize(iter->vxstr))));
+    if(iter->reverse){
+      tcbdbcurprev(cur);
+    } else {
+      tcbdbcurnext(cur);
+    }
+  }
+  return iter->vrecs;
+}
+
+
 static void fdb_init(void){
   cls_fdb = rb_define_class_under(mod_tokyocabinet, "FDB", rb_cObject);
-  cls_fdb_data = rb_define_class_under(mod_tokyocabinet, "FDB_data", rb_cObject);
+  rb_define_alloc_func(cls_fdb, fdb_alloc);
   rb_define_const(cls_fdb, "ESUCCESS", INT2NUM(TCESUCCESS));
   rb_define_const(cls_fdb, "ETHREAD", INT2NUM(TCETHREAD));
   rb_define_const(cls_fdb, "EINVALID", INT2NUM(TCEINVALID));
@@ -1962,7 +3857,7 @@ static void fdb_init(void){
   rb_define_const(cls_fdb, "OTRUNC", INT2NUM(FDBOTRUNC));
   rb_define_const(cls_fdb, "ONOLCK", INT2NUM(FDBONOLCK));
   rb_define_const(cls_fdb, "OLCKNB", INT2NUM(FDBOLCKNB));
-  rb_objc_define_method(cls_fdb, "initialize", fdb_initialize, 0);
+  rb_objc_define_method(cls_fdb, "initialize", fdb_initialize, -1);
   rb_objc_define_method(cls_fdb, "errmsg", fdb_errmsg, -1);
   rb_objc_define_method(cls_fdb, "ecode", fdb_ecode, 0);
   rb_objc_define_method(cls_fdb, "tune", fdb_tune, -1);
@@ -1971,12 +3866,19 @@ static void fdb_init(void){
   rb_objc_define_method(cls_fdb, "put", fdb_put, 2);
   rb_objc_define_method(cls_fdb, "putkeep", fdb_putkeep, 2);
   rb_objc_define_method(cls_fdb, "putcat", fdb_putcat, 2);
+  rb_objc_define_method(cls_fdb, "put_all", fdb_put_all, -1);
   rb_objc_define_method(cls_fdb, "out", fdb_out, 1);
+  rb_objc_define_method(cls_fdb, "mout", fdb_mout, -1);
   rb_objc_define_method(cls_fdb, "get", fdb_get, 1);
+  rb_objc_define_method(cls_fdb, "mget", fdb_mget, 1);
+  rb_objc_define_method(cls_fdb, "get_into", fdb_get_into, 2);
+  rb_objc_define_method(cls_fdb, "get_id", fdb_get_id, 1);
   rb_objc_define_method(cls_fdb, "vsiz", fdb_vsiz, 1);
   rb_objc_define_method(cls_fdb, "iterinit", fdb_iterinit, 0);
   rb_objc_define_method(cls_fdb, "iternext", fdb_iternext, 0);
+  rb_objc_define_method(cls_fdb, "iternext_id", fdb_iternext_id, 0);
   rb_objc_define_method(cls_fdb, "range", fdb_range, -1);
+  rb_objc_define_method(cls_fdb, "range_ids", fdb_range_ids, -1);
   rb_objc_define_method(cls_fdb, "addint", fdb_addint, 2);
   rb_objc_define_method(cls_fdb, "adddouble", fdb_adddouble, 2);
   rb_objc_define_method(cls_fdb, "sync", fdb_sync, 0);
@@ -2006,6 +3908,9 @@ static void fdb_init(void){
   rb_objc_define_method(cls_fdb, "length", fdb_rnum, 0);
   rb_objc_define_method(cls_fdb, "empty?", fdb_empty, 0);
   rb_objc_define_method(cls_fdb, "each", fdb_each, 0);
+  rb_objc_define_method(cls_fdb, "each_batch", fdb_each_batch, 1);
+  rb_objc_define_method(cls_fdb, "each_id", fdb_each_id, 0);
+  rb_objc_define_method(cls_fdb, "each_id_range", fdb_each_id_range, -1);
   rb_objc_define_method(cls_fdb, "each_pair", fdb_each, 0);
   rb_objc_define_method(cls_fdb, "each_key", fdb_each_key, 0);
   rb_objc_define_method(cls_fdb, "each_value", fdb_each_value, 0);
@@ -2014,163 +3919,293 @@ static void fdb_init(void){
 }
 
 
-static VALUE fdb_initialize(VALUE vself, SEL sel){
-  VALUE vfdb;
-  TCFDB *fdb;
-  fdb = tcfdbnew();
-  tcfdbsetmutex(fdb);
-  vfdb = Data_Wrap_Struct(cls_fdb_data, 0, tcfdbdel, fdb);
-  rb_iv_set(vself, FDBVNDATA, vfdb);
+static void fdb_free(FDBDATA *data){
+  tcfdbdel(data->fdb);
+  tcfree(data);
+}
+
+
+static VALUE fdb_alloc(VALUE klass){
+  FDBDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->fdb = tcfdbnew();
+  data->owner = Qnil;
+  return WrapDATA(klass, &fdb_type, data);
+}
+
+
+static VALUE fdb_initialize(RBVARARGS){
+  VALUE vopts;
+  FDBDATA *data;
+  rb_scan_args(argc, argv, "01", &vopts);
+  GetFDBDATA(vself, data);
+  data->owner = setowner(vself, vopts);
+  if(data->owner == Qnil) tcfdbsetmutex(data->fdb);
   return Qnil;
 }
 
 
-static VALUE fdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vecode;
+static VALUE fdb_errmsg(RBVARARGS){
+  VALUE vecode;
   TCFDB *fdb;
   const char *msg;
   int ecode;
   rb_scan_args(argc, argv, "01", &vecode);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   ecode = (vecode == Qnil) ? tcfdbecode(fdb) : NUM2INT(vecode);
   msg = tcfdberrmsg(ecode);
   return rb_str_new2(msg);
 }
 
 
-static VALUE fdb_ecode(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_ecode(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return INT2NUM(tcfdbecode(fdb));
 }
 
 
-static VALUE fdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vwidth, vlimsiz;
+static VALUE fdb_tune(RBVARARGS){
+  VALUE vwidth, vlimsiz;
   TCFDB *fdb;
   int width;
   int64_t limsiz;
   rb_scan_args(argc, argv, "02", &vwidth, &vlimsiz);
   width = (vwidth == Qnil) ? -1 : NUM2INT(vwidth);
   limsiz = (vlimsiz == Qnil) ? -1 : NUM2LL(vlimsiz);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbtune(fdb, width, limsiz) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_open(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vpath, vomode;
+static VALUE fdb_open(RBVARARGS){
+  VALUE vpath, vomode;
   TCFDB *fdb;
   int omode;
   rb_scan_args(argc, argv, "11", &vpath, &vomode);
   Check_Type(vpath, T_STRING);
   omode = (vomode == Qnil) ? FDBOREADER : NUM2INT(vomode);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbopen(fdb, RSTRING_PTR(vpath), omode) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_close(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_close(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbclose(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vfdb;
+static VALUE fdb_put(RBSELF, VALUE vkey, VALUE vval){
+  TCFDB *fdb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetFDB(vself, fdb);
+  return tcfdbput2(fdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE fdb_putkeep(RBSELF, VALUE vkey, VALUE vval){
+  TCFDB *fdb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetFDB(vself, fdb);
+  return tcfdbputkeep2(fdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE fdb_putcat(RBSELF, VALUE vkey, VALUE vval){
+  TCFDB *fdb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetFDB(vself, fdb);
+  return tcfdbputcat2(fdb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE fdb_put_all(RBVARARGS){
+  VALUE vrecs, vopts, vkey, vfails;
+  TCFDB *fdb;
+  VALBUF key, val;
+  int i, num, mode, cnt;
+  bool tran, ok;
+  rb_scan_args(argc, argv, "11", &vrecs, &vopts);
+  mode = vputmode(vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetFDB(vself, fdb);
+  vrecs = vrecstoary(vrecs, KCSTRING);
+  if(tran && !tcfdbtranbegin(fdb)) return Qnil;
+  vfails = rb_ary_new();
+  cnt = 0;
+  num = RARRAY_LEN(vrecs);
+  for(i = 0; i < num; i += 2){
+    vkey = rb_ary_entry(vrecs, i);
+    StringValueBuf(vkey, &key);
+    StringValueBuf(rb_ary_entry(vrecs, i + 1), &val);
+    switch(mode){
+    case PMKEEP:
+      ok = tcfdbputkeep2(fdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    case PMCAT:
+      ok = tcfdbputcat2(fdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    default:
+      ok = tcfdbput2(fdb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    }
+    if(ok){
+      cnt++;
+    } else {
+      rb_ary_push(vfails, vkey);
+    }
+  }
+  if(tran && !tcfdbtrancommit(fdb)){
+    tcfdbtranabort(fdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vfails);
+}
+
+
+static VALUE fdb_out(RBSELF, VALUE vkey){
+  TCFDB *fdb;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  return tcfdbout2(fdb, key.ptr, key.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE fdb_mout(RBVARARGS){
+  VALUE vkeys, vopts, vkey, vmiss;
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return tcfdbput2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                   RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key;
+  int i, num, cnt;
+  bool tran, err;
+  rb_scan_args(argc, argv, "11", &vkeys, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetFDB(vself, fdb);
+  vkeys = vkeystoary(vkeys, KCSTRING);
+  if(tran && !tcfdbtranbegin(fdb)) return Qnil;
+  vmiss = rb_ary_new();
+  cnt = 0;
+  err = false;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if(tcfdbout2(fdb, key.ptr, key.size)){
+      cnt++;
+    } else if(tcfdbecode(fdb) == TCENOREC){
+      rb_ary_push(vmiss, vkey);
+    } else {
+      err = true;
+      break;
+    }
+  }
+  if(err){
+    if(tran) tcfdbtranabort(fdb);
+    return Qnil;
+  }
+  if(tran && !tcfdbtrancommit(fdb)){
+    tcfdbtranabort(fdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vmiss);
 }
 
 
-static VALUE fdb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vfdb;
+static VALUE fdb_get(RBSELF, VALUE vkey){
+  VALUE vval;
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return tcfdbputkeep2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                       RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key;
+  char *vbuf;
+  int vsiz;
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  if(!(vbuf = tcfdbget2(fdb, key.ptr, key.size, &vsiz))) return Qnil;
+  vval = rb_str_new(vbuf, vsiz);
+  tcfree(vbuf);
+  return vval;
 }
 
 
-static VALUE fdb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vfdb;
+static VALUE fdb_mget(RBSELF, VALUE vkeys){
+  VALUE vkey, vhash;
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return tcfdbputcat2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                      RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key;
+  char *vbuf;
+  int i, num, vsiz;
+  Check_Type(vkeys, T_ARRAY);
+  GetFDB(vself, fdb);
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if((vbuf = tcfdbget2(fdb, key.ptr, key.size, &vsiz)) != NULL){
+      rb_hash_aset(vhash, vkey, rb_str_new(vbuf, vsiz));
+      tcfree(vbuf);
+    }
+  }
+  return vhash;
 }
 
 
-static VALUE fdb_out(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vfdb;
+static VALUE fdb_get_into(RBSELF, VALUE vkey, VALUE vbuf){
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return tcfdbout2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  char *buf;
+  int max, vsiz;
+  if(vbuf == vkey) rb_raise(rb_eArgError, "the buffer must not be the key");
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  buf = vstrreserve(vbuf, tcfdbwidth(fdb), &max);
+  if((vsiz = tcfdbget4(fdb, tcfdbkeytoid(key.ptr, key.size), buf, max)) < 0) return Qnil;
+  vstrsetlen(vbuf, vsiz);
+  return vbuf;
 }
 
 
-static VALUE fdb_get(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vfdb, vval;
+static VALUE fdb_get_id(RBSELF, VALUE vid){
+  VALUE vval;
   TCFDB *fdb;
   char *vbuf;
   int vsiz;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  if(!(vbuf = tcfdbget2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz))) return Qnil;
+  GetFDB(vself, fdb);
+  if(!(vbuf = tcfdbget(fdb, NUM2LL(vid), &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
   return vval;
 }
 
 
-static VALUE fdb_vsiz(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vfdb;
+static VALUE fdb_vsiz(RBSELF, VALUE vkey){
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return INT2NUM(tcfdbvsiz2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)));
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  return INT2NUM(tcfdbvsiz2(fdb, key.ptr, key.size));
 }
 
 
-static VALUE fdb_iterinit(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_iterinit(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbiterinit(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_iternext(VALUE vself, SEL sel){
-  VALUE vfdb, vval;
+static VALUE fdb_iternext(RBSELF){
+  VALUE vval;
   TCFDB *fdb;
   char *vbuf;
   int vsiz;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   if(!(vbuf = tcfdbiternext2(fdb, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
@@ -2178,155 +4213,164 @@ static VALUE fdb_iternext(VALUE vself, SEL sel){
 }
 
 
-static VALUE fdb_range(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vinterval, vmax, vary;
+static VALUE fdb_iternext_id(RBSELF){
+  TCFDB *fdb;
+  uint64_t id;
+  GetFDB(vself, fdb);
+  if((id = tcfdbiternext(fdb)) < 1) return Qnil;
+  return ULL2NUM(id);
+}
+
+
+static VALUE fdb_range(RBVARARGS){
+  VALUE vinterval, vmax, vary;
   TCFDB *fdb;
   TCLIST *keys;
+  VALBUF interval;
   int max;
   rb_scan_args(argc, argv, "11", &vinterval, &vmax);
-  vinterval = StringValueEx(vinterval);
+  StringValueBuf(vinterval, &interval);
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  keys = tcfdbrange4(fdb, RSTRING_PTR(vinterval), RSTRING_LEN(vinterval), max);
+  GetFDB(vself, fdb);
+  keys = tcfdbrange4(fdb, interval.ptr, interval.size, max);
   vary = listtovary(keys);
   tclistdel(keys);
   return vary;
 }
 
 
-static VALUE fdb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vfdb;
+static VALUE fdb_range_ids(RBVARARGS){
+  VALUE vlower, vupper, vmax, vary;
+  TCFDB *fdb;
+  uint64_t *ids;
+  int64_t lower, upper;
+  int i, max, num;
+  rb_scan_args(argc, argv, "03", &vlower, &vupper, &vmax);
+  lower = (vlower == Qnil) ? FDBIDMIN : NUM2LL(vlower);
+  upper = (vupper == Qnil) ? FDBIDMAX : NUM2LL(vupper);
+  max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
+  GetFDB(vself, fdb);
+  ids = tcfdbrange(fdb, lower, upper, max, &num);
+  vary = rb_ary_new2(num);
+  for(i = 0; i < num; i++){
+    rb_ary_push(vary, ULL2NUM(ids[i]));
+  }
+  tcfree(ids);
+  return vary;
+}
+
+
+static VALUE fdb_addint(RBSELF, VALUE vkey, VALUE vnum){
   TCFDB *fdb;
+  VALBUF key;
   int num;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  num = tcfdbaddint(fdb, tcfdbkeytoid(RSTRING_PTR(vkey), RSTRING_LEN(vkey)), NUM2INT(vnum));
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  num = tcfdbaddint(fdb, tcfdbkeytoid(key.ptr, key.size), NUM2INT(vnum));
   return num == INT_MIN ? Qnil : INT2NUM(num);
 }
 
 
-static VALUE fdb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vfdb;
+static VALUE fdb_adddouble(RBSELF, VALUE vkey, VALUE vnum){
   TCFDB *fdb;
+  VALBUF key;
   double num;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  num = tcfdbadddouble(fdb, tcfdbkeytoid(RSTRING_PTR(vkey), RSTRING_LEN(vkey)), NUM2DBL(vnum));
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  num = tcfdbadddouble(fdb, tcfdbkeytoid(key.ptr, key.size), NUM2DBL(vnum));
   return isnan(num) ? Qnil : rb_float_new(num);
 }
 
 
-static VALUE fdb_sync(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_sync(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbsync(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vwidth, vlimsiz;
+static VALUE fdb_optimize(RBVARARGS){
+  VALUE vwidth, vlimsiz;
   TCFDB *fdb;
   int width;
   int64_t limsiz;
   rb_scan_args(argc, argv, "02", &vwidth, &vlimsiz);
   width = (vwidth == Qnil) ? -1 : NUM2INT(vwidth);
   limsiz = (vlimsiz == Qnil) ? -1 : NUM2LL(vlimsiz);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdboptimize(fdb, width, limsiz) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_vanish(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_vanish(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbvanish(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_copy(VALUE vself, SEL sel, VALUE vpath){
-  VALUE vfdb;
+static VALUE fdb_copy(RBSELF, VALUE vpath){
   TCFDB *fdb;
   Check_Type(vpath, T_STRING);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbcopy(fdb, RSTRING_PTR(vpath)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_tranbegin(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_tranbegin(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbtranbegin(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_trancommit(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_trancommit(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbtrancommit(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_tranabort(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_tranabort(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbtranabort(fdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_path(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_path(RBSELF){
   TCFDB *fdb;
   const char *path;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   if(!(path = tcfdbpath(fdb))) return Qnil;
   return rb_str_new2(path);
 }
 
 
-static VALUE fdb_rnum(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_rnum(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return LL2NUM(tcfdbrnum(fdb));
 }
 
 
-static VALUE fdb_fsiz(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_fsiz(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return LL2NUM(tcfdbfsiz(fdb));
 }
 
 
-static VALUE fdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vfdb, vkey, vdef, vval;
+static VALUE fdb_fetch(RBVARARGS){
+  VALUE vkey, vdef, vval;
   TCFDB *fdb;
+  VALBUF key;
   char *vbuf;
   int vsiz;
   rb_scan_args(argc, argv, "11", &vkey, &vdef);
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  if((vbuf = tcfdbget2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz)) != NULL){
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  if((vbuf = tcfdbget2(fdb, key.ptr, key.size, &vsiz)) != NULL){
     vval = rb_str_new(vbuf, vsiz);
     tcfree(vbuf);
   } else {
@@ -2336,32 +4380,30 @@ static VALUE fdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE fdb_check(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vfdb;
+static VALUE fdb_check(RBSELF, VALUE vkey){
   TCFDB *fdb;
-  vkey = StringValueEx(vkey);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  return tcfdbvsiz2(fdb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) >= 0 ? Qtrue : Qfalse;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetFDB(vself, fdb);
+  return tcfdbvsiz2(fdb, key.ptr, key.size) >= 0 ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_check_value(VALUE vself, SEL sel, VALUE vval){
-  VALUE vfdb;
+static VALUE fdb_check_value(RBSELF, VALUE vval){
   TCFDB *fdb;
+  VALBUF val;
   char *tvbuf;
   bool hit;
   int tvsiz;
   uint64_t id;
-  vval = StringValueEx(vval);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  StringValueBuf(vval, &val);
+  GetFDB(vself, fdb);
   hit = false;
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
     tvbuf = tcfdbget(fdb, id, &tvsiz);
-    if(tvbuf && tvsiz == RSTRING_LEN(vval) &&
-       memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvbuf && tvsiz == val.size &&
+       memcmp(tvbuf, val.ptr, val.size) == 0){
       tcfree(tvbuf);
       hit = true;
       break;
@@ -2372,21 +4414,21 @@ static VALUE fdb_check_value(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE fdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
-  VALUE vfdb, vrv;
+static VALUE fdb_get_reverse(RBSELF, VALUE vval){
+  VALUE vrv;
   TCFDB *fdb;
+  VALBUF val;
   char *tvbuf, kbuf[NUMBUFSIZ];
   int tvsiz, ksiz;
   uint64_t id;
-  vval = StringValueEx(vval);
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  StringValueBuf(vval, &val);
+  GetFDB(vself, fdb);
   vrv = Qnil;
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
     tvbuf = tcfdbget(fdb, id, &tvsiz);
-    if(tvbuf && tvsiz == RSTRING_LEN(vval) &&
-       memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvbuf && tvsiz == val.size &&
+       memcmp(tvbuf, val.ptr, val.size) == 0){
       tcfree(tvbuf);
       ksiz = sprintf(kbuf, "%llu", (unsigned long long)id);
       vrv = rb_str_new(kbuf, ksiz);
@@ -2398,121 +4440,167 @@ static VALUE fdb_get_reverse(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE fdb_empty(VALUE vself, SEL sel){
-  VALUE vfdb;
+static VALUE fdb_empty(RBSELF){
   TCFDB *fdb;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  GetFDB(vself, fdb);
   return tcfdbrnum(fdb) < 1 ? Qtrue : Qfalse;
 }
 
 
-static VALUE fdb_each(VALUE vself, SEL sel){
-  VALUE vfdb, vrv;
+static VALUE fdb_each(RBSELF){
+  VALUE vrv, vval;
   TCFDB *fdb;
   char *vbuf, kbuf[NUMBUFSIZ];
   int vsiz, ksiz;
   uint64_t id;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  if(!rb_block_given_p()) return vnewenum(vself, "each", 0, NULL, true);
+  GetFDB(vself, fdb);
   vrv = Qnil;
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
     vbuf = tcfdbget(fdb, id, &vsiz);
     if(vbuf){
       ksiz = sprintf(kbuf, "%llu", (unsigned long long)id);
-      vrv = rb_yield_values(2, rb_str_new(kbuf, ksiz), rb_str_new(vbuf, vsiz));
+      vval = rb_str_new(vbuf, vsiz);
+      tcfree(vbuf);
+      vrv = rb_yield_values(2, rb_str_new(kbuf, ksiz), vval);
     }
-    tcfree(vbuf);
   }
   return vrv;
 }
 
 
-static VALUE fdb_each_key(VALUE vself, SEL sel){
-  VALUE vfdb, vrv;
+static VALUE fdb_each_batch(RBSELF, VALUE vnum){
+  VALUE vrv, vrecs;
   TCFDB *fdb;
-  char kbuf[NUMBUFSIZ];
-  int ksiz;
+  char *vbuf, kbuf[NUMBUFSIZ];
+  int num, vsiz, ksiz;
   uint64_t id;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  GetFDB(vself, fdb);
   vrv = Qnil;
+  vrecs = batchnew(num);
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
-    ksiz = sprintf(kbuf, "%llu", (unsigned long long)id);
-    vrv = rb_yield(rb_str_new(kbuf, ksiz));
+    vbuf = tcfdbget(fdb, id, &vsiz);
+    if(vbuf){
+      ksiz = sprintf(kbuf, "%llu", (unsigned long long)id);
+      rb_ary_push(vrecs, rb_assoc_new(rb_str_new(kbuf, ksiz), rb_str_new(vbuf, vsiz)));
+      tcfree(vbuf);
+    }
+    if(RARRAY_LEN(vrecs) >= num){
+      vrv = rb_yield(vrecs);
+      vrecs = batchnew(num);
+    }
   }
+  if(RARRAY_LEN(vrecs) > 0) vrv = rb_yield(vrecs);
   return vrv;
 }
 
 
-static VALUE fdb_each_value(VALUE vself, SEL sel){
-  VALUE vfdb, vrv;
-  TCFDB *fdb;
-  char *vbuf;
-  int vsiz;
-  uint64_t id;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  vrv = Qnil;
-  tcfdbiterinit(fdb);
-  while((id = tcfdbiternext(fdb)) > 0){
-    vbuf = tcfdbget(fdb, id, &vsiz);
-    if(vbuf){
-      vrv = rb_yield(rb_str_new(vbuf, vsiz));
+static VALUE fdb_iterate(VALUE viter){
+  ITERDATA *iter;
+  int64_t lower, id;
+  int i, num, vsiz;
+  iter = (ITERDATA *)viter;
+  lower = iter->lid;
+  while(true){
+    iter->ids = tcfdbrange(iter->obj, lower, iter->uid, FDBRANGEUNIT, &num);
+    for(i = 0; i < num; i++){
+      id = iter->ids[i];
+      if((vsiz = tcfdbget4(iter->obj, id, iter->rbuf, iter->rsiz)) < 0) continue;
+      iteryield(iter, (char *)&id, sizeof(id), iter->rbuf, vsiz);
     }
-    free(vbuf);
+    lower = (num > 0) ? iter->ids[num-1] + 1 : 0;
+    tcfree(iter->ids);
+    iter->ids = NULL;
+    if(num < FDBRANGEUNIT) break;
   }
-  return vrv;
+  return iterfinish(iter);
+}
+
+
+static VALUE fdb_each_id(RBSELF){
+  return fdbeachids(vself, "each_id", 0, NULL, Qnil, Qnil);
 }
 
 
-static VALUE fdb_keys(VALUE vself, SEL sel){
-  VALUE vfdb, vary;
+static VALUE fdb_each_id_range(RBVARARGS){
+  VALUE vlower, vupper;
+  rb_scan_args(argc, argv, "02", &vlower, &vupper);
+  return fdbeachids(vself, "each_id_range", argc, argv, vlower, vupper);
+}
+
+
+static VALUE fdbeachids(VALUE vself, const char *name, int argc, VALUE *argv, VALUE vlower, VALUE vupper){
+  TCFDB *fdb;
+  ITERDATA iter;
+  if(!rb_block_given_p()) return vnewenum(vself, name, argc, argv, argc < 1);
+  GetFDB(vself, fdb);
+  iterinit(&iter, fdb, IMPAIR, 0, KCINT64);
+  iter.lid = (vlower == Qnil) ? FDBIDMIN : NUM2LL(vlower);
+  iter.uid = (vupper == Qnil) ? FDBIDMAX : NUM2LL(vupper);
+  iter.rsiz = tcfdbwidth(fdb);
+  iter.rbuf = tcmalloc(iter.rsiz + 1);
+  return rb_ensure(fdb_iterate, (VALUE)&iter, iterfree, (VALUE)&iter);
+}
+
+
+static VALUE fdb_each_key(RBSELF){
+  VALUE vrv;
   TCFDB *fdb;
   char kbuf[NUMBUFSIZ];
   int ksiz;
   uint64_t id;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  vary = rb_ary_new2(tcfdbrnum(fdb));
+  if(!rb_block_given_p()) return vnewenum(vself, "each_key", 0, NULL, true);
+  GetFDB(vself, fdb);
+  vrv = Qnil;
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
     ksiz = sprintf(kbuf, "%llu", (unsigned long long)id);
-    rb_ary_push(vary, rb_str_new(kbuf, ksiz));
+    vrv = rb_yield(rb_str_new(kbuf, ksiz));
   }
-  return vary;
+  return vrv;
 }
 
 
-static VALUE fdb_values(VALUE vself, SEL sel){
-  VALUE vfdb, vary;
+static VALUE fdb_each_value(RBSELF){
+  VALUE vrv, vval;
   TCFDB *fdb;
   char *vbuf;
   int vsiz;
   uint64_t id;
-  vfdb = rb_iv_get(vself, FDBVNDATA);
-  Data_Get_Struct(vfdb, TCFDB, fdb);
-  vary = rb_ary_new2(tcfdbrnum(fdb));
+  if(!rb_block_given_p()) return vnewenum(vself, "each_value", 0, NULL, true);
+  GetFDB(vself, fdb);
+  vrv = Qnil;
   tcfdbiterinit(fdb);
   while((id = tcfdbiternext(fdb)) > 0){
     vbuf = tcfdbget(fdb, id, &vsiz);
     if(vbuf){
-      rb_ary_push(vary, rb_str_new(vbuf, vsiz));
+      vval = rb_str_new(vbuf, vsiz);
+      tcfree(vbuf);
+      vrv = rb_yield(vval);
     }
-    free(vbuf);
   }
-  return vary;
+  return vrv;
+}
+
+
+static VALUE fdb_keys(RBSELF){
+  return vnewenum(vself, "each_key", 0, NULL, true);
+}
+
+
+static VALUE fdb_values(RBSELF){
+  return vnewenum(vself, "each_value", 0, NULL, true);
 }
 
 
 static void tdb_init(void){
   cls_tdb = rb_define_class_under(mod_tokyocabinet, "TDB", rb_cObject);
-  cls_tdb_data = rb_define_class_under(mod_tokyocabinet, "TDB_data", rb_cObject);
+  rb_define_alloc_func(cls_tdb, tdb_alloc);
   rb_define_const(cls_tdb, "ESUCCESS", INT2NUM(TCESUCCESS));
   rb_define_const(cls_tdb, "ETHREAD", INT2NUM(TCETHREAD));
   rb_define_const(cls_tdb, "EINVALID", INT2NUM(TCEINVALID));
@@ -2554,7 +4642,7 @@ static void tdb_init(void){
   rb_define_const(cls_tdb, "ITQGRAM", INT2NUM(TDBITQGRAM));
   rb_define_const(cls_tdb, "ITVOID", INT2NUM(TDBITVOID));
   rb_define_const(cls_tdb, "ITKEEP", INT2NUM(TDBITKEEP));
-  rb_objc_define_method(cls_tdb, "initialize", tdb_initialize, 0);
+  rb_objc_define_method(cls_tdb, "initialize", tdb_initialize, -1);
   rb_objc_define_method(cls_tdb, "errmsg", tdb_errmsg, -1);
   rb_objc_define_method(cls_tdb, "ecode", tdb_ecode, 0);
   rb_objc_define_method(cls_tdb, "tune", tdb_tune, -1);
@@ -2567,7 +4655,9 @@ static void tdb_init(void){
   rb_objc_define_method(cls_tdb, "putkeep", tdb_putkeep, 2);
   rb_objc_define_method(cls_tdb, "putcat", tdb_putcat, 2);
   rb_objc_define_method(cls_tdb, "out", tdb_out, 1);
-  rb_objc_define_method(cls_tdb, "get", tdb_get, 1);
+  rb_objc_define_method(cls_tdb, "mout", tdb_mout, -1);
+  rb_objc_define_method(cls_tdb, "get", tdb_get, -1);
+  rb_objc_define_method(cls_tdb, "mget", tdb_mget, -1);
   rb_objc_define_method(cls_tdb, "vsiz", tdb_vsiz, 1);
   rb_objc_define_method(cls_tdb, "iterinit", tdb_iterinit, 0);
   rb_objc_define_method(cls_tdb, "iternext", tdb_iternext, 0);
@@ -2586,7 +4676,7 @@ static void tdb_init(void){
   rb_objc_define_method(cls_tdb, "fsiz", tdb_fsiz, 0);
   rb_objc_define_method(cls_tdb, "setindex", tdb_setindex, 2);
   rb_objc_define_method(cls_tdb, "genuid", tdb_genuid, 0);
-  rb_objc_define_method(cls_tdb, "[]", tdb_get, 1);
+  rb_objc_define_method(cls_tdb, "[]", tdb_get, -1);
   rb_objc_define_method(cls_tdb, "[]=", tdb_put, 2);
   rb_objc_define_method(cls_tdb, "store", tdb_put, 2);
   rb_objc_define_method(cls_tdb, "delete", tdb_out, 1);
@@ -2599,8 +4689,9 @@ static void tdb_init(void){
   rb_objc_define_method(cls_tdb, "size", tdb_rnum, 0);
   rb_objc_define_method(cls_tdb, "length", tdb_rnum, 0);
   rb_objc_define_method(cls_tdb, "empty?", tdb_empty, 0);
-  rb_objc_define_method(cls_tdb, "each", tdb_each, 0);
-  rb_objc_define_method(cls_tdb, "each_pair", tdb_each, 0);
+  rb_objc_define_method(cls_tdb, "each", tdb_each, -1);
+  rb_objc_define_method(cls_tdb, "each_batch", tdb_each_batch, 1);
+  rb_objc_define_method(cls_tdb, "each_pair", tdb_each, -1);
   rb_objc_define_method(cls_tdb, "each_key", tdb_each_key, 0);
   rb_objc_define_method(cls_tdb, "each_value", tdb_each_value, 0);
   rb_objc_define_method(cls_tdb, "keys", tdb_keys, 0);
@@ -2608,42 +4699,54 @@ static void tdb_init(void){
 }
 
 
-static VALUE tdb_initialize(VALUE vself, SEL sel){
-  VALUE vtdb;
-  TCTDB *tdb;
-  tdb = tctdbnew();
-  tctdbsetmutex(tdb);
-  vtdb = Data_Wrap_Struct(cls_tdb_data, 0, tctdbdel, tdb);
-  rb_iv_set(vself, TDBVNDATA, vtdb);
+static void tdb_free(TDBDATA *data){
+  tctdbdel(data->tdb);
+  tcfree(data);
+}
+
+
+static VALUE tdb_alloc(VALUE klass){
+  TDBDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->tdb = tctdbnew();
+  data->owner = Qnil;
+  return WrapDATA(klass, &tdb_type, data);
+}
+
+
+static VALUE tdb_initialize(RBVARARGS){
+  VALUE vopts;
+  TDBDATA *data;
+  rb_scan_args(argc, argv, "01", &vopts);
+  GetTDBDATA(vself, data);
+  data->owner = setowner(vself, vopts);
+  if(data->owner == Qnil) tctdbsetmutex(data->tdb);
   return Qnil;
 }
 
 
-static VALUE tdb_errmsg(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vecode;
+static VALUE tdb_errmsg(RBVARARGS){
+  VALUE vecode;
   TCTDB *tdb;
   const char *msg;
   int ecode;
   rb_scan_args(argc, argv, "01", &vecode);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   ecode = (vecode == Qnil) ? tctdbecode(tdb) : NUM2INT(vecode);
   msg = tctdberrmsg(ecode);
   return rb_str_new2(msg);
 }
 
 
-static VALUE tdb_ecode(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_ecode(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return INT2NUM(tctdbecode(tdb));
 }
 
 
-static VALUE tdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vbnum, vapow, vfpow, vopts;
+static VALUE tdb_tune(RBVARARGS){
+  VALUE vbnum, vapow, vfpow, vopts;
   TCTDB *tdb;
   int apow, fpow, opts;
   int64_t bnum;
@@ -2652,167 +4755,220 @@ static VALUE tdb_tune(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? 0 : NUM2INT(vopts);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbtune(tdb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_setcache(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vrcnum, vlcnum, vncnum;
+static VALUE tdb_setcache(RBVARARGS){
+  VALUE vrcnum, vlcnum, vncnum;
   TCTDB *tdb;
   int rcnum, lcnum, ncnum;
   rb_scan_args(argc, argv, "03", &vrcnum, &vlcnum, &vncnum);
   rcnum = (vrcnum == Qnil) ? -1 : NUM2INT(vrcnum);
   lcnum = (vlcnum == Qnil) ? -1 : NUM2INT(vlcnum);
   ncnum = (vncnum == Qnil) ? -1 : NUM2INT(vncnum);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbsetcache(tdb, rcnum, lcnum, ncnum) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_setxmsiz(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vxmsiz;
+static VALUE tdb_setxmsiz(RBVARARGS){
+  VALUE vxmsiz;
   TCTDB *tdb;
   int64_t xmsiz;
   rb_scan_args(argc, argv, "01", &vxmsiz);
   xmsiz = (vxmsiz == Qnil) ? -1 : NUM2LL(vxmsiz);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbsetxmsiz(tdb, xmsiz) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_setdfunit(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vdfunit;
+static VALUE tdb_setdfunit(RBVARARGS){
+  VALUE vdfunit;
   TCTDB *tdb;
   int32_t dfunit;
   rb_scan_args(argc, argv, "01", &vdfunit);
   dfunit = (vdfunit == Qnil) ? -1 : NUM2INT(vdfunit);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbsetdfunit(tdb, dfunit) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_open(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vpath, vomode;
+static VALUE tdb_open(RBVARARGS){
+  VALUE vpath, vomode;
   TCTDB *tdb;
   int omode;
   rb_scan_args(argc, argv, "11", &vpath, &vomode);
   Check_Type(vpath, T_STRING);
   omode = (vomode == Qnil) ? TDBOREADER : NUM2INT(vomode);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbopen(tdb, RSTRING_PTR(vpath), omode) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_close(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_close(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbclose(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_put(VALUE vself, SEL sel, VALUE vpkey, VALUE vcols){
-  VALUE vtdb, vrv;
+static VALUE tdb_put(RBSELF, VALUE vpkey, VALUE vcols){
+  VALUE vrv;
   TCTDB *tdb;
   TCMAP *cols;
-  vpkey = StringValueEx(vpkey);
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
   Check_Type(vcols, T_HASH);
   cols = vhashtomap(vcols);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vrv = tctdbput(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey), cols) ? Qtrue : Qfalse;
+  GetTDB(vself, tdb);
+  vrv = tctdbput(tdb, pkey.ptr, pkey.size, cols) ? Qtrue : Qfalse;
   tcmapdel(cols);
   return vrv;
 }
 
 
-static VALUE tdb_putkeep(VALUE vself, SEL sel, VALUE vpkey, VALUE vcols){
-  VALUE vtdb, vrv;
+static VALUE tdb_putkeep(RBSELF, VALUE vpkey, VALUE vcols){
+  VALUE vrv;
   TCTDB *tdb;
   TCMAP *cols;
-  vpkey = StringValueEx(vpkey);
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
   Check_Type(vcols, T_HASH);
   cols = vhashtomap(vcols);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vrv = tctdbputkeep(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey), cols) ? Qtrue : Qfalse;
+  GetTDB(vself, tdb);
+  vrv = tctdbputkeep(tdb, pkey.ptr, pkey.size, cols) ? Qtrue : Qfalse;
   tcmapdel(cols);
   return vrv;
 }
 
 
-static VALUE tdb_putcat(VALUE vself, SEL sel, VALUE vpkey, VALUE vcols){
-  VALUE vtdb, vrv;
+static VALUE tdb_putcat(RBSELF, VALUE vpkey, VALUE vcols){
+  VALUE vrv;
   TCTDB *tdb;
   TCMAP *cols;
-  vpkey = StringValueEx(vpkey);
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
   Check_Type(vcols, T_HASH);
   cols = vhashtomap(vcols);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vrv = tctdbputcat(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey), cols) ? Qtrue : Qfalse;
+  GetTDB(vself, tdb);
+  vrv = tctdbputcat(tdb, pkey.ptr, pkey.size, cols) ? Qtrue : Qfalse;
   tcmapdel(cols);
   return vrv;
 }
 
 
-static VALUE tdb_out(VALUE vself, SEL sel, VALUE vpkey){
-  VALUE vtdb;
+static VALUE tdb_out(RBSELF, VALUE vpkey){
+  TCTDB *tdb;
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  return tctdbout(tdb, pkey.ptr, pkey.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE tdb_mout(RBVARARGS){
+  VALUE vkeys, vopts, vkey, vmiss;
   TCTDB *tdb;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  return tctdbout(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  int i, num, cnt;
+  bool tran, err;
+  rb_scan_args(argc, argv, "11", &vkeys, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetTDB(vself, tdb);
+  vkeys = vkeystoary(vkeys, KCSTRING);
+  if(tran && !tctdbtranbegin(tdb)) return Qnil;
+  vmiss = rb_ary_new();
+  cnt = 0;
+  err = false;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if(tctdbout(tdb, key.ptr, key.size)){
+      cnt++;
+    } else if(tctdbecode(tdb) == TCENOREC){
+      rb_ary_push(vmiss, vkey);
+    } else {
+      err = true;
+      break;
+    }
+  }
+  if(err){
+    if(tran) tctdbtranabort(tdb);
+    return Qnil;
+  }
+  if(tran && !tctdbtrancommit(tdb)){
+    tctdbtranabort(tdb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vmiss);
 }
 
 
-static VALUE tdb_get(VALUE vself, SEL sel, VALUE vpkey){
-  VALUE vtdb, vcols;
+static VALUE tdb_get(RBVARARGS){
+  VALUE vpkey, vopts, vnames, vcols;
   TCTDB *tdb;
   TCMAP *cols;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  if(!(cols = tctdbget(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey)))) return Qnil;
-  vcols = maptovhash(cols);
+  VALBUF pkey;
+  rb_scan_args(argc, argv, "11", &vpkey, &vopts);
+  StringValueBuf(vpkey, &pkey);
+  vnames = vcolsopt(vopts);
+  GetTDB(vself, tdb);
+  if(!(cols = tctdbget(tdb, pkey.ptr, pkey.size))) return Qnil;
+  vcols = maptovhashcols(cols, vnames);
   tcmapdel(cols);
   return vcols;
 }
 
 
-static VALUE tdb_vsiz(VALUE vself, SEL sel, VALUE vpkey){
-  VALUE vtdb;
+static VALUE tdb_mget(RBVARARGS){
+  VALUE vpkeys, vopts, vnames, vpkey, vhash;
+  TCTDB *tdb;
+  TCMAP *cols;
+  VALBUF pkey;
+  int i, num;
+  rb_scan_args(argc, argv, "11", &vpkeys, &vopts);
+  Check_Type(vpkeys, T_ARRAY);
+  vnames = vcolsopt(vopts);
+  GetTDB(vself, tdb);
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vpkeys);
+  for(i = 0; i < num; i++){
+    vpkey = rb_ary_entry(vpkeys, i);
+    StringValueBuf(vpkey, &pkey);
+    if((cols = tctdbget(tdb, pkey.ptr, pkey.size)) != NULL){
+      rb_hash_aset(vhash, vpkey, maptovhashcols(cols, vnames));
+      tcmapdel(cols);
+    }
+  }
+  return vhash;
+}
+
+
+static VALUE tdb_vsiz(RBSELF, VALUE vpkey){
   TCTDB *tdb;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  return INT2NUM(tctdbvsiz(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey)));
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  return INT2NUM(tctdbvsiz(tdb, pkey.ptr, pkey.size));
 }
 
 
-static VALUE tdb_iterinit(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_iterinit(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbiterinit(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_iternext(VALUE vself, SEL sel){
-  VALUE vtdb, vval;
+static VALUE tdb_iternext(RBSELF){
+  VALUE vval;
   TCTDB *tdb;
   char *vbuf;
   int vsiz;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   if(!(vbuf = tctdbiternext(tdb, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
@@ -2820,58 +4976,54 @@ static VALUE tdb_iternext(VALUE vself, SEL sel){
 }
 
 
-static VALUE tdb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vprefix, vmax, vary;
+static VALUE tdb_fwmkeys(RBVARARGS){
+  VALUE vprefix, vmax, vary;
   TCTDB *tdb;
   TCLIST *pkeys;
+  VALBUF prefix;
   int max;
   rb_scan_args(argc, argv, "11", &vprefix, &vmax);
-  vprefix = StringValueEx(vprefix);
+  StringValueBuf(vprefix, &prefix);
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  pkeys = tctdbfwmkeys(tdb, RSTRING_PTR(vprefix), RSTRING_LEN(vprefix), max);
+  GetTDB(vself, tdb);
+  pkeys = tctdbfwmkeys(tdb, prefix.ptr, prefix.size, max);
   vary = listtovary(pkeys);
   tclistdel(pkeys);
   return vary;
 }
 
 
-static VALUE tdb_addint(VALUE vself, SEL sel, VALUE vpkey, VALUE vnum){
-  VALUE vtdb;
+static VALUE tdb_addint(RBSELF, VALUE vpkey, VALUE vnum){
   TCTDB *tdb;
+  VALBUF pkey;
   int num;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  num = tctdbaddint(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey), NUM2INT(vnum));
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  num = tctdbaddint(tdb, pkey.ptr, pkey.size, NUM2INT(vnum));
   return num == INT_MIN ? Qnil : INT2NUM(num);
 }
 
 
-static VALUE tdb_adddouble(VALUE vself, SEL sel, VALUE vpkey, VALUE vnum){
-  VALUE vtdb;
+static VALUE tdb_adddouble(RBSELF, VALUE vpkey, VALUE vnum){
   TCTDB *tdb;
+  VALBUF pkey;
   double num;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  num = tctdbadddouble(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey), NUM2DBL(vnum));
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  num = tctdbadddouble(tdb, pkey.ptr, pkey.size, NUM2DBL(vnum));
   return isnan(num) ? Qnil : rb_float_new(num);
 }
 
 
-static VALUE tdb_sync(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_sync(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbsync(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vbnum, vapow, vfpow, vopts;
+static VALUE tdb_optimize(RBVARARGS){
+  VALUE vbnum, vapow, vfpow, vopts;
   TCTDB *tdb;
   int apow, fpow, opts;
   int64_t bnum;
@@ -2880,116 +5032,96 @@ static VALUE tdb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
   apow = (vapow == Qnil) ? -1 : NUM2INT(vapow);
   fpow = (vfpow == Qnil) ? -1 : NUM2INT(vfpow);
   opts = (vopts == Qnil) ? UINT8_MAX : NUM2INT(vopts);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdboptimize(tdb, bnum, apow, fpow, opts) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_vanish(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_vanish(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbvanish(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_copy(VALUE vself, SEL sel, VALUE vpath){
-  VALUE vtdb;
+static VALUE tdb_copy(RBSELF, VALUE vpath){
   TCTDB *tdb;
   Check_Type(vpath, T_STRING);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbcopy(tdb, RSTRING_PTR(vpath)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_tranbegin(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_tranbegin(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbtranbegin(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_trancommit(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_trancommit(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbtrancommit(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_tranabort(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_tranabort(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbtranabort(tdb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_path(VALUE vself, SEL sel){
-  VALUE vtdb, vpath;
+static VALUE tdb_path(RBSELF){
+  VALUE vpath;
   TCTDB *tdb;
   const char *path;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   if(!(path = tctdbpath(tdb))) return Qnil;
   vpath = rb_str_new2(path);
   return vpath;
 }
 
 
-static VALUE tdb_rnum(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_rnum(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return LL2NUM(tctdbrnum(tdb));
 }
 
 
-static VALUE tdb_fsiz(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_fsiz(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return LL2NUM(tctdbfsiz(tdb));
 }
 
 
-static VALUE tdb_setindex(VALUE vself, SEL sel, VALUE vname, VALUE vtype){
-  VALUE vtdb;
+static VALUE tdb_setindex(RBSELF, VALUE vname, VALUE vtype){
   TCTDB *tdb;
   Check_Type(vname, T_STRING);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbsetindex(tdb, RSTRING_PTR(vname), NUM2INT(vtype)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_genuid(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_genuid(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return LL2NUM(tctdbgenuid(tdb));
 }
 
 
-static VALUE tdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vtdb, vpkey, vdef, vcols;
+static VALUE tdb_fetch(RBVARARGS){
+  VALUE vpkey, vdef, vcols;
   TCTDB *tdb;
   TCMAP *cols;
+  VALBUF pkey;
   rb_scan_args(argc, argv, "11", &vpkey, &vdef);
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  if((cols = tctdbget(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey))) != NULL){
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  if((cols = tctdbget(tdb, pkey.ptr, pkey.size)) != NULL){
     vcols = maptovhash(cols);
     tcmapdel(cols);
   } else {
@@ -2999,128 +5131,123 @@ static VALUE tdb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE tdb_check(VALUE vself, SEL sel, VALUE vpkey){
-  VALUE vtdb;
+static VALUE tdb_check(RBSELF, VALUE vpkey){
   TCTDB *tdb;
-  vpkey = StringValueEx(vpkey);
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  return tctdbvsiz(tdb, RSTRING_PTR(vpkey), RSTRING_LEN(vpkey)) >= 0 ? Qtrue : Qfalse;
+  VALBUF pkey;
+  StringValueBuf(vpkey, &pkey);
+  GetTDB(vself, tdb);
+  return tctdbvsiz(tdb, pkey.ptr, pkey.size) >= 0 ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_empty(VALUE vself, SEL sel){
-  VALUE vtdb;
+static VALUE tdb_empty(RBSELF){
   TCTDB *tdb;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  GetTDB(vself, tdb);
   return tctdbrnum(tdb) < 1 ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdb_each(VALUE vself, SEL sel){
-  VALUE vtdb, vrv;
-  TCTDB *tdb;
+static VALUE tdbiternext(TCTDB *tdb, VALUE *vpkey, VALUE vnames){
+  VALUE vcols;
   TCMAP *cols;
-  char *kbuf;
-  int ksiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vrv = Qnil;
-  tctdbiterinit(tdb);
-  while((kbuf = tctdbiternext(tdb, &ksiz)) != NULL){
-    if((cols = tctdbget(tdb, kbuf, ksiz)) != NULL){
-      vrv = rb_yield_values(2, rb_str_new(kbuf, ksiz), maptovhash(cols));
-      tcmapdel(cols);
-    }
-    tcfree(kbuf);
+  const char *pkbuf;
+  int pksiz;
+  if(!(cols = tctdbiternext3(tdb))) return Qnil;
+  if(vpkey){
+    pkbuf = tcmapget(cols, "", 0, &pksiz);
+    *vpkey = pkbuf ? rb_str_new(pkbuf, pksiz) : rb_str_new("", 0);
   }
-  return vrv;
+  tcmapout(cols, "", 0);
+  vcols = maptovhashcols(cols, vnames);
+  tcmapdel(cols);
+  return vcols;
 }
 
 
-static VALUE tdb_each_key(VALUE vself, SEL sel){
-  VALUE vtdb, vrv;
+static VALUE tdb_each(RBVARARGS){
+  VALUE vopts, vnames, vrv, vkey, vcols;
   TCTDB *tdb;
-  char *kbuf;
-  int ksiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "each", argc, argv, true);
+  vnames = vcolsopt(vopts);
+  GetTDB(vself, tdb);
   vrv = Qnil;
   tctdbiterinit(tdb);
-  while((kbuf = tctdbiternext(tdb, &ksiz)) != NULL){
-    vrv = rb_yield(rb_str_new(kbuf, ksiz));
-    tcfree(kbuf);
+  while((vcols = tdbiternext(tdb, &vkey, vnames)) != Qnil){
+    vrv = rb_yield_values(2, vkey, vcols);
   }
   return vrv;
 }
 
 
-static VALUE tdb_each_value(VALUE vself, SEL sel){
-  VALUE vtdb, vrv;
+static VALUE tdb_each_batch(RBSELF, VALUE vnum){
+  VALUE vrv, vrecs, vkey, vcols;
   TCTDB *tdb;
-  TCMAP *cols;
-  char *kbuf;
-  int ksiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
+  int num;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  GetTDB(vself, tdb);
   vrv = Qnil;
+  vrecs = batchnew(num);
   tctdbiterinit(tdb);
-  while((kbuf = tctdbiternext(tdb, &ksiz)) != NULL){
-    if((cols = tctdbget(tdb, kbuf, ksiz)) != NULL){
-      vrv = rb_yield(maptovhash(cols));
-      tcmapdel(cols);
+  while((vcols = tdbiternext(tdb, &vkey, Qnil)) != Qnil){
+    rb_ary_push(vrecs, rb_assoc_new(vkey, vcols));
+    if(RARRAY_LEN(vrecs) >= num){
+      vrv = rb_yield(vrecs);
+      vrecs = batchnew(num);
     }
-    tcfree(kbuf);
   }
+  if(RARRAY_LEN(vrecs) > 0) vrv = rb_yield(vrecs);
   return vrv;
 }
 
 
-static VALUE tdb_keys(VALUE vself, SEL sel){
-  VALUE vtdb, vary;
+static VALUE tdb_each_key(RBSELF){
+  VALUE vrv, vkey;
   TCTDB *tdb;
   char *kbuf;
   int ksiz;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vary = rb_ary_new2(tctdbrnum(tdb));
+  if(!rb_block_given_p()) return vnewenum(vself, "each_key", 0, NULL, true);
+  GetTDB(vself, tdb);
+  vrv = Qnil;
   tctdbiterinit(tdb);
   while((kbuf = tctdbiternext(tdb, &ksiz)) != NULL){
-    rb_ary_push(vary, rb_str_new(kbuf, ksiz));
+    vkey = rb_str_new(kbuf, ksiz);
     tcfree(kbuf);
+    vrv = rb_yield(vkey);
   }
-  return vary;
+  return vrv;
 }
 
 
-static VALUE tdb_values(VALUE vself, SEL sel){
-  VALUE vtdb, vary;
+static VALUE tdb_each_value(RBSELF){
+  VALUE vrv, vcols;
   TCTDB *tdb;
-  TCMAP *cols;
-  char *kbuf;
-  int ksiz;
-  vtdb = rb_iv_get(vself, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  vary = rb_ary_new2(tctdbrnum(tdb));
-  tctdbiterinit(tdb);
-  while((kbuf = tctdbiternext(tdb, &ksiz)) != NULL){
-    if((cols = tctdbget(tdb, kbuf, ksiz)) != NULL){
-      rb_ary_push(vary, maptovhash(cols));
-      tcmapdel(cols);
-    }
-    tcfree(kbuf);
+  if(!rb_block_given_p()) return vnewenum(vself, "each_value", 0, NULL, true);
+  GetTDB(vself, tdb);
+  vrv = Qnil;
+  tctdbiterinit(tdb);
+  while((vcols = tdbiternext(tdb, NULL, Qnil)) != Qnil){
+    vrv = rb_yield(vcols);
   }
-  return vary;
+  return vrv;
+}
+
+
+static VALUE tdb_keys(RBSELF){
+  return vnewenum(vself, "each_key", 0, NULL, true);
+}
+
+
+static VALUE tdb_values(RBSELF){
+  return vnewenum(vself, "each_value", 0, NULL, true);
 }
 
 
 static void tdbqry_init(void){
   cls_tdbqry = rb_define_class_under(mod_tokyocabinet, "TDBQRY", rb_cObject);
-  cls_tdbqry_data = rb_define_class_under(mod_tokyocabinet, "TDBQRY_data", rb_cObject);
+  rb_define_alloc_func(cls_tdbqry, tdbqry_alloc);
   rb_define_const(cls_tdbqry, "QCSTREQ", INT2NUM(TDBQCSTREQ));
   rb_define_const(cls_tdbqry, "QCSTRINC", INT2NUM(TDBQCSTRINC));
   rb_define_const(cls_tdbqry, "QCSTRBW", INT2NUM(TDBQCSTRBW));
@@ -3163,8 +5290,13 @@ static void tdbqry_init(void){
   rb_objc_define_method(cls_tdbqry, "setlimit", tdbqry_setlimit, -1);
   rb_objc_define_method(cls_tdbqry, "setmax", tdbqry_setlimit, -1);
   rb_objc_define_method(cls_tdbqry, "search", tdbqry_search, 0);
+  rb_objc_define_method(cls_tdbqry, "search_rows", tdbqry_search_rows, -1);
+  rb_objc_define_method(cls_tdbqry, "count", tdbqry_count, 0);
   rb_objc_define_method(cls_tdbqry, "searchout", tdbqry_searchout, 0);
   rb_objc_define_method(cls_tdbqry, "proc", tdbqry_proc, 0);
+  rb_objc_define_method(cls_tdbqry, "each", tdbqry_each, 0);
+  rb_objc_define_method(cls_tdbqry, "each_batch", tdbqry_each_batch, 1);
+  rb_objc_define_method(cls_tdbqry, "aggregate", tdbqry_aggregate, -1);
   rb_objc_define_method(cls_tdbqry, "hint", tdbqry_hint, 0);
   rb_objc_define_method(cls_tdbqry, "metasearch", tdbqry_metasearch, -1);
   rb_objc_define_method(cls_tdbqry, "kwic", tdbqry_kwic, -1);
@@ -3172,155 +5304,345 @@ static void tdbqry_init(void){
 
 
 static int tdbqry_procrec(const void *pkbuf, int pksiz, TCMAP *cols, void *opq){
-  VALUE vpkey, vcols, vrv, vkeys, vkey, vval;
-  int i, rv, num;
-  vpkey = rb_str_new(pkbuf, pksiz);
-  vcols = maptovhash(cols);
-  vrv = rb_yield_values(2, vpkey, vcols);
-  rv = (vrv == Qnil) ? 0 : NUM2INT(vrv);
-  if(rv & TDBQPPUT){
-    tcmapclear(cols);
-    vkeys = rb_funcall(vcols, rb_intern("keys"), 0);
-    num = RARRAY_LEN(vkeys);
-    for(i = 0; i < num; i++){
-      vkey = rb_ary_entry(vkeys, i);
-      vval = rb_hash_aref(vcols, vkey);
-      vkey = StringValueEx(vkey);
-      vval = StringValueEx(vval);
-      tcmapput(cols, RSTRING_PTR(vkey), RSTRING_LEN(vkey), RSTRING_PTR(vval), RSTRING_LEN(vval));
+  QRYITER *iter = opq;
+  iter->pkbuf = pkbuf;
+  iter->pksiz = pksiz;
+  iter->cols = cols;
+  iter->flags = 0;
+  rb_protect(tdbqry_procyield, (VALUE)iter, &iter->state);
+  if(iter->vrow != Qnil){
+    if(!rowexpire(iter->vrow)) iter->flags &= ~TDBQPPUT;
+    iter->vrow = Qnil;
+  }
+  return iter->state ? TDBQPSTOP : iter->flags;
+}
+
+
+static VALUE tdbqry_procyield(VALUE viter){
+  VALUE vrv;
+  QRYITER *iter;
+  iter = (QRYITER *)viter;
+  iter->vrow = rownew(iter->cols);
+  vrv = rb_yield_values(2, rb_str_new(iter->pkbuf, iter->pksiz), iter->vrow);
+  iter->flags = (vrv == Qnil) ? 0 : NUM2INT(vrv);
+  return Qnil;
+}
+
+
+static VALUE tdbqry_eachyield(VALUE viter){
+  VALUE vchunk, vpair, vrecs;
+  QRYITER *iter;
+  int i, start, pnum, cnum;
+  iter = (QRYITER *)viter;
+  pnum = tclistnum(iter->pkeys);
+  for(start = 0; start < pnum; start += QRYITERUNIT){
+    vchunk = tdbqryfetch(iter->tdb, iter->pkeys, start, QRYITERUNIT, iter->vnames);
+    cnum = RARRAY_LEN(vchunk);
+    for(i = 0; i < cnum; i++){
+      vpair = rb_ary_entry(vchunk, i);
+      if(iter->mode != IMBATCH){
+        iter->vrv = rb_yield_values(2, rb_ary_entry(vpair, 0), rb_ary_entry(vpair, 1));
+        continue;
+      }
+      rb_ary_push(iter->vrecs, vpair);
+      if(RARRAY_LEN(iter->vrecs) >= iter->num){
+        vrecs = iter->vrecs;
+        iter->vrecs = batchnew(iter->num);
+        iter->vrv = rb_yield(vrecs);
+      }
     }
   }
-  return rv;
+  if(iter->mode == IMBATCH && RARRAY_LEN(iter->vrecs) > 0) iter->vrv = rb_yield(iter->vrecs);
+  return iter->vrv;
 }
 
 
-static VALUE tdbqry_initialize(VALUE vself, SEL sel, VALUE vtdb){
-  VALUE vqry;
-  TCTDB *tdb;
-  TDBQRY *qry;
-  Check_Type(vtdb, T_OBJECT);
-  vtdb = rb_iv_get(vtdb, TDBVNDATA);
-  Data_Get_Struct(vtdb, TCTDB, tdb);
-  qry = tctdbqrynew(tdb);
-  vqry = Data_Wrap_Struct(cls_tdbqry_data, 0, tctdbqrydel, qry);
-  rb_iv_set(vself, TDBQRYVNDATA, vqry);
+static VALUE tdbqry_eachfree(VALUE viter){
+  QRYITER *iter;
+  iter = (QRYITER *)viter;
+  tclistdel(iter->pkeys);
+  return Qnil;
+}
+
+
+static VALUE tdbqry_rowsfill(VALUE viter){
+  QRYITER *iter;
+  int start, pnum;
+  iter = (QRYITER *)viter;
+  pnum = tclistnum(iter->pkeys);
+  for(start = 0; start < pnum; start += QRYITERUNIT){
+    rb_ary_concat(iter->vrecs, tdbqryfetch(iter->tdb, iter->pkeys, start, QRYITERUNIT, iter->vnames));
+  }
+  return iter->vrecs;
+}
+
+
+static VALUE tdbqryfetch(TCTDB *tdb, TCLIST *pkeys, int start, int num, VALUE vnames){
+  VALUE vrecs;
+  BLOCKCALL call;
+  TCMAP **rows;
+  const char *pkbuf;
+  int i, pksiz;
+  call.obj = tdb;
+  call.rv = pkeys;
+  call.nums[0] = start;
+  call.nums[1] = num;
+  callblocking(tdbqryfetch_blocking, &call, Qnil, Qnil);
+  rows = call.rv;
+  vrecs = rb_ary_new2(call.rsiz);
+  for(i = 0; i < call.rsiz; i++){
+    if(!rows[i]) continue;
+    pkbuf = tclistval(pkeys, start + i, &pksiz);
+    rb_ary_push(vrecs, rb_assoc_new(rb_str_new(pkbuf, pksiz), maptovhashcols(rows[i], vnames)));
+    tcmapdel(rows[i]);
+  }
+  tcfree(rows);
+  return vrecs;
+}
+
+
+static void tdbqry_free(TDBQRYDATA *data){
+  if(data->qry) tctdbqrydel(data->qry);
+  tcfree(data);
+}
+
+
+static VALUE tdbqry_alloc(VALUE klass){
+  TDBQRYDATA *data;
+  data = tcmalloc(sizeof(*data));
+  data->qry = NULL;
+  data->tdata = NULL;
+  data->busy = false;
+  return WrapDATA(klass, &tdbqry_type, data);
+}
+
+
+static VALUE tdbqry_initialize(RBSELF, VALUE vtdb){
+  TDBQRYDATA *data;
+  TDBDATA *tdata;
+  if(rb_obj_is_kind_of(vtdb, cls_tdb) != Qtrue)
+    rb_raise(rb_eTypeError, "wrong argument type %s (expected TDB)", rb_obj_classname(vtdb));
+  GetTDBDATA(vtdb, tdata);
+  GetDATA(vself, TDBQRYDATA, &tdbqry_type, data);
+  if(data->busy) rb_raise(rb_eThreadError, "the query is being searched by another thread");
+  if(data->qry) tctdbqrydel(data->qry);
+  data->qry = tctdbqrynew(tdata->tdb);
+  data->tdata = tdata;
   rb_iv_set(vself, TDBVNDATA, vtdb);
   return Qnil;
 }
 
 
-static VALUE tdbqry_addcond(VALUE vself, SEL sel, VALUE vname, VALUE vop, VALUE vexpr){
-  VALUE vqry;
+static VALUE tdbqry_addcond(RBSELF, VALUE vname, VALUE vop, VALUE vexpr){
   TDBQRY *qry;
   vname = StringValueEx(vname);
   vexpr = StringValueEx(vexpr);
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   tctdbqryaddcond(qry, RSTRING_PTR(vname), NUM2INT(vop), RSTRING_PTR(vexpr));
   return Qnil;
 }
 
 
-static VALUE tdbqry_setorder(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vqry, vname, vtype;
+static VALUE tdbqry_setorder(RBVARARGS){
+  VALUE vname, vtype;
   TDBQRY *qry;
   int type;
   rb_scan_args(argc, argv, "11", &vname, &vtype);
   vname = StringValueEx(vname);
   type = (vtype == Qnil) ? TDBQOSTRASC : NUM2INT(vtype);
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   tctdbqrysetorder(qry, RSTRING_PTR(vname), type);
   return Qnil;
 }
 
 
-static VALUE tdbqry_setlimit(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vqry, vmax, vskip;
+static VALUE tdbqry_setlimit(RBVARARGS){
+  VALUE vmax, vskip;
   TDBQRY *qry;
   int max, skip;
   rb_scan_args(argc, argv, "02", &vmax, &vskip);
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
   skip = (vskip == Qnil) ? -1 : NUM2INT(vskip);
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   tctdbqrysetlimit(qry, max, skip);
   return Qnil;
 }
 
 
-static VALUE tdbqry_search(VALUE vself, SEL sel){
-  VALUE vqry, vary;
-  TDBQRY *qry;
+static VALUE tdbqry_search(RBSELF){
+  VALUE vary;
+  TDBQRYDATA *data;
   TCLIST *res;
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
-  res = tctdbqrysearch(qry);
+  BLOCKCALL call;
+  GetTDBQRYDATA(vself, data);
+  call.obj = data->qry;
+  qrycallblocking(data, tdbqrysearch_blocking, &call, Qnil, Qnil);
+  res = call.rv;
   vary = listtovary(res);
   tclistdel(res);
   return vary;
 }
 
 
-static VALUE tdbqry_searchout(VALUE vself, SEL sel){
-  VALUE vqry;
+static VALUE tdbqry_count(RBSELF){
+  TDBQRYDATA *data;
+  BLOCKCALL call;
+  GetTDBQRYDATA(vself, data);
+  call.obj = data->qry;
+  qrycallblocking(data, tdbqrycount_blocking, &call, Qnil, Qnil);
+  return LL2NUM(call.nums[0]);
+}
+
+
+static VALUE tdbqry_search_rows(RBVARARGS){
+  VALUE vopts;
+  TDBQRYDATA *data;
+  QRYITER iter;
+  BLOCKCALL call;
+  rb_scan_args(argc, argv, "01", &vopts);
+  GetTDBQRYDATA(vself, data);
+  iter.vnames = vcolsopt(vopts);
+  iter.vrecs = rb_ary_new();
+  call.obj = data->qry;
+  qrycallblocking(data, tdbqrysearch_blocking, &call, Qnil, Qnil);
+  iter.tdb = data->tdata->tdb;
+  iter.pkeys = call.rv;
+  return rb_ensure(tdbqry_rowsfill, (VALUE)&iter, tdbqry_eachfree, (VALUE)&iter);
+}
+
+
+static VALUE tdbqry_searchout(RBSELF){
   TDBQRY *qry;
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   return tctdbqrysearchout(qry) ? Qtrue : Qfalse;
 }
 
 
-static VALUE tdbqry_proc(VALUE vself, SEL sel, VALUE vproc){
-  VALUE vqry;
+static VALUE tdbqry_proc(RBSELF){
   TDBQRY *qry;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
-  return tctdbqryproc(qry, (TDBQRYPROC)tdbqry_procrec, NULL) ? Qtrue : Qfalse;
+  QRYITER iter;
+  bool rv;
+  if(!rb_block_given_p()) rb_raise(rb_eArgError, "no block given");
+  GetTDBQRY(vself, qry);
+  iter.vrow = Qnil;
+  iter.state = 0;
+  rv = tctdbqryproc(qry, (TDBQRYPROC)tdbqry_procrec, &iter);
+  if(iter.state) rb_jump_tag(iter.state);
+  return rv ? Qtrue : Qfalse;
+}
+
+
+static VALUE tdbqry_each(RBSELF){
+  if(!rb_block_given_p()) return vnewenum(vself, "each", 0, NULL, false);
+  return tdbqryiterate(vself, IMPAIR, 0);
 }
 
 
-static VALUE tdbqry_hint(VALUE vself, SEL sel){
-  VALUE vqry;
+static VALUE tdbqry_each_batch(RBSELF, VALUE vnum){
+  int num;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  return tdbqryiterate(vself, IMBATCH, num);
+}
+
+
+static VALUE tdbqryiterate(VALUE vself, int mode, int num){
+  TDBQRYDATA *data;
+  QRYITER iter;
+  BLOCKCALL call;
+  GetTDBQRYDATA(vself, data);
+  iter.mode = mode;
+  iter.num = num;
+  iter.vrecs = (mode == IMBATCH) ? batchnew(num) : Qnil;
+  iter.vnames = Qnil;
+  iter.vrv = Qnil;
+  call.obj = data->qry;
+  qrycallblocking(data, tdbqrysearch_blocking, &call, Qnil, Qnil);
+  iter.tdb = data->tdata->tdb;
+  iter.pkeys = call.rv;
+  return rb_ensure(tdbqry_eachyield, (VALUE)&iter, tdbqry_eachfree, (VALUE)&iter);
+}
+
+
+static VALUE tdbqry_aggregate(RBVARARGS){
+  VALUE vname, vfunc, vopts, vgname, vrv;
+  TDBQRYDATA *data;
+  AGGDATA agg;
+  BLOCKCALL call;
+  AGGSTATE state;
+  const char *gbuf;
+  const void *sbuf;
+  int func, gsiz, ssiz;
+  rb_scan_args(argc, argv, "21", &vname, &vfunc, &vopts);
+  func = vaggfunc(vfunc);
+  if(vname == Qnil && func != AFCOUNT) rb_raise(rb_eArgError, "no column to aggregate");
+  vgname = vhashopt(vopts, "group_by");
+  memset(&agg, 0, sizeof(agg));
+  memset(&call, 0, sizeof(call));
+  if(vname != Qnil){
+    vname = StringValueEx(vname);
+    call.kbuf = RSTRING_PTR(vname);
+    call.ksiz = RSTRING_LEN(vname);
+  }
+  if(vgname != Qnil){
+    vgname = StringValueEx(vgname);
+    call.vbuf = RSTRING_PTR(vgname);
+    call.vsiz = RSTRING_LEN(vgname);
+  }
+  GetTDBQRYDATA(vself, data);
+  if(vgname != Qnil) agg.groups = tcmapnew();
+  agg.tdb = data->tdata->tdb;
+  call.obj = data->qry;
+  call.rv = &agg;
+  qrycallblocking(data, tdbqryagg_blocking, &call, vname, vgname);
+  if(!agg.groups) return aggvalue(&agg.total, func);
+  vrv = rb_hash_new();
+  tcmapiterinit(agg.groups);
+  while((gbuf = tcmapiternext(agg.groups, &gsiz)) != NULL){
+    sbuf = tcmapiterval(gbuf, &ssiz);
+    memcpy(&state, sbuf, sizeof(state));
+    rb_hash_aset(vrv, rb_str_new(gbuf, gsiz), aggvalue(&state, func));
+  }
+  tcmapdel(agg.groups);
+  if(agg.total.cnt > 0) rb_hash_aset(vrv, Qnil, aggvalue(&agg.total, func));
+  return vrv;
+}
+
+
+static VALUE tdbqry_hint(RBSELF){
   TDBQRY *qry;
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   return rb_str_new2(tctdbqryhint(qry));
 }
 
 
-static VALUE tdbqry_metasearch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vqry, vothers, vtype, voqry, vary;
+static VALUE tdbqry_metasearch(RBVARARGS){
+  VALUE vothers, vtype, voqry, vary;
   TDBQRY *qry, **qrys;
   TCLIST *res;
   int i, type, num, qnum;
   rb_scan_args(argc, argv, "11", &vothers, &vtype);
   Check_Type(vothers, T_ARRAY);
   type = (vtype == Qnil) ? TDBMSUNION : NUM2INT(vtype);
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   num = RARRAY_LEN(vothers);
-  qrys = tcmalloc(sizeof(*qrys) * (num + 1));
+  qrys = ALLOCA_N(TDBQRY *, num + 1);
   qnum = 0;
   qrys[qnum++] = qry;
   for(i = 0; i < num; i++){
     voqry = rb_ary_entry(vothers, i);
-    if(rb_obj_is_instance_of(voqry, cls_tdbqry) == Qtrue){
-      voqry = rb_iv_get(voqry, TDBQRYVNDATA);
-      Data_Get_Struct(voqry, TDBQRY, qrys[qnum++]);
-    }
+    if(rb_obj_is_kind_of(voqry, cls_tdbqry) == Qtrue) GetTDBQRY(voqry, qrys[qnum++]);
   }
   res = tctdbmetasearch(qrys, qnum, type);
   vary = listtovary(res);
-  tcfree(qrys);
   tclistdel(res);
   return vary;
 }
 
 
-static VALUE tdbqry_kwic(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vqry, vcols, vname, vwidth, vopts, vval, vary;
+static VALUE tdbqry_kwic(RBVARARGS){
+  VALUE vcols, vname, vwidth, vopts, vval, vary;
   TDBQRY *qry;
   TCMAP *cols;
   const char *name;
@@ -3344,8 +5666,7 @@ static VALUE tdbqry_kwic(VALUE vself, SEL sel, int argc, VALUE *argv){
     width = 1 << 30;
     opts |= TCKWNOOVER | TCKWPULEAD;
   }
-  vqry = rb_iv_get(vself, TDBQRYVNDATA);
-  Data_Get_Struct(vqry, TDBQRY, qry);
+  GetTDBQRY(vself, qry);
   TCLIST *texts = tctdbqrykwic(qry, cols, name, width, opts);
   vary = listtovary(texts);
   tclistdel(texts);
@@ -3356,15 +5677,19 @@ static VALUE tdbqry_kwic(VALUE vself, SEL sel, int argc, VALUE *argv){
 
 static void adb_init(void){
   cls_adb = rb_define_class_under(mod_tokyocabinet, "ADB", rb_cObject);
-  cls_adb_data = rb_define_class_under(mod_tokyocabinet, "ADB_data", rb_cObject);
+  rb_define_alloc_func(cls_adb, adb_alloc);
   rb_define_private_method(cls_adb, "initialize", adb_initialize, 0);
   rb_objc_define_method(cls_adb, "open", adb_open, 1);
   rb_objc_define_method(cls_adb, "close", adb_close, 0);
   rb_objc_define_method(cls_adb, "put", adb_put, 2);
   rb_objc_define_method(cls_adb, "putkeep", adb_putkeep, 2);
   rb_objc_define_method(cls_adb, "putcat", adb_putcat, 2);
+  rb_objc_define_method(cls_adb, "put_all", adb_put_all, -1);
   rb_objc_define_method(cls_adb, "out", adb_out, 1);
+  rb_objc_define_method(cls_adb, "mout", adb_mout, -1);
   rb_objc_define_method(cls_adb, "get", adb_get, 1);
+  rb_objc_define_method(cls_adb, "mget", adb_mget, 1);
+  rb_objc_define_method(cls_adb, "get_into", adb_get_into, 2);
   rb_objc_define_method(cls_adb, "vsiz", adb_vsiz, 1);
   rb_objc_define_method(cls_adb, "iterinit", adb_iterinit, 0);
   rb_objc_define_method(cls_adb, "iternext", adb_iternext, 0);
@@ -3399,6 +5724,8 @@ static void adb_init(void){
   rb_objc_define_method(cls_adb, "length", adb_rnum, 0);
   rb_objc_define_method(cls_adb, "empty?", adb_empty, 0);
   rb_objc_define_method(cls_adb, "each", adb_each, 0);
+  rb_objc_define_method(cls_adb, "each_batch", adb_each_batch, 1);
+  rb_objc_define_method(cls_adb, "parallel_each", adb_parallel_each, -1);
   rb_objc_define_method(cls_adb, "each_pair", adb_each, 0);
   rb_objc_define_method(cls_adb, "each_key", adb_each_key, 0);
   rb_objc_define_method(cls_adb, "each_value", adb_each_value, 0);
@@ -3407,122 +5734,221 @@ static void adb_init(void){
 }
 
 
-static VALUE adb_initialize(VALUE vself, SEL sel){
-  VALUE vadb;
-  TCADB *adb;
-  adb = tcadbnew();
-  vadb = Data_Wrap_Struct(cls_adb_data, 0, tcadbdel, adb);
-  rb_iv_set(vself, ADBVNDATA, vadb);
+static VALUE adb_alloc(VALUE klass){
+  return WrapDATA(klass, &adb_type, tcadbnew());
+}
+
+
+static VALUE adb_initialize(RBSELF){
   return Qnil;
 }
 
 
-static VALUE adb_open(VALUE vself, SEL sel, VALUE vname){
-  VALUE vadb;
+static VALUE adb_open(RBSELF, VALUE vname){
   TCADB *adb;
   Check_Type(vname, T_STRING);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbopen(adb, RSTRING_PTR(vname)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_close(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_close(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbclose(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_put(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vadb;
+static VALUE adb_put(RBSELF, VALUE vkey, VALUE vval){
+  TCADB *adb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetADB(vself, adb);
+  return tcadbput(adb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE adb_putkeep(RBSELF, VALUE vkey, VALUE vval){
+  TCADB *adb;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetADB(vself, adb);
+  return tcadbputkeep(adb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
+}
+
+
+static VALUE adb_putcat(RBSELF, VALUE vkey, VALUE vval){
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return tcadbput(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                  RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  StringValueBuf(vkey, &key);
+  StringValueBuf(vval, &val);
+  GetADB(vself, adb);
+  return tcadbputcat(adb, key.ptr, key.size, val.ptr, val.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_putkeep(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vadb;
+static VALUE adb_put_all(RBVARARGS){
+  VALUE vrecs, vopts, vkey, vfails;
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return tcadbputkeep(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                      RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key, val;
+  int i, num, mode, cnt;
+  bool tran, ok;
+  rb_scan_args(argc, argv, "11", &vrecs, &vopts);
+  mode = vputmode(vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetADB(vself, adb);
+  vrecs = vrecstoary(vrecs, KCSTRING);
+  if(tran && !tcadbtranbegin(adb)) return Qnil;
+  vfails = rb_ary_new();
+  cnt = 0;
+  num = RARRAY_LEN(vrecs);
+  for(i = 0; i < num; i += 2){
+    vkey = rb_ary_entry(vrecs, i);
+    StringValueBuf(vkey, &key);
+    StringValueBuf(rb_ary_entry(vrecs, i + 1), &val);
+    switch(mode){
+    case PMKEEP:
+      ok = tcadbputkeep(adb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    case PMCAT:
+      ok = tcadbputcat(adb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    default:
+      ok = tcadbput(adb, key.ptr, key.size, val.ptr, val.size);
+      break;
+    }
+    if(ok){
+      cnt++;
+    } else {
+      rb_ary_push(vfails, vkey);
+    }
+  }
+  if(tran && !tcadbtrancommit(adb)){
+    tcadbtranabort(adb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vfails);
 }
 
 
-static VALUE adb_putcat(VALUE vself, SEL sel, VALUE vkey, VALUE vval){
-  VALUE vadb;
+static VALUE adb_out(RBSELF, VALUE vkey){
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vval = StringValueEx(vval);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return tcadbputcat(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey),
-                     RSTRING_PTR(vval), RSTRING_LEN(vval)) ? Qtrue : Qfalse;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  return tcadbout(adb, key.ptr, key.size) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_out(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vadb;
+static VALUE adb_mout(RBVARARGS){
+  VALUE vkeys, vopts, vkey, vmiss;
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return tcadbout(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) ? Qtrue : Qfalse;
+  VALBUF key;
+  int i, num, cnt;
+  bool tran;
+  rb_scan_args(argc, argv, "11", &vkeys, &vopts);
+  tran = vhashopt(vopts, "transactional") != Qfalse;
+  GetADB(vself, adb);
+  vkeys = vkeystoary(vkeys, KCSTRING);
+  if(tran && !tcadbtranbegin(adb)) return Qnil;
+  vmiss = rb_ary_new();
+  cnt = 0;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if(tcadbout(adb, key.ptr, key.size)){
+      cnt++;
+    } else {
+      rb_ary_push(vmiss, vkey);
+    }
+  }
+  if(tran && !tcadbtrancommit(adb)){
+    tcadbtranabort(adb);
+    return Qnil;
+  }
+  return rb_assoc_new(INT2NUM(cnt), vmiss);
 }
 
 
-static VALUE adb_get(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vadb, vval;
+static VALUE adb_get(RBSELF, VALUE vkey){
+  VALUE vval;
   TCADB *adb;
+  VALBUF key;
   char *vbuf;
   int vsiz;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  if(!(vbuf = tcadbget(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz))) return Qnil;
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  if(!(vbuf = tcadbget(adb, key.ptr, key.size, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
   return vval;
 }
 
 
-static VALUE adb_vsiz(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vadb;
+static VALUE adb_mget(RBSELF, VALUE vkeys){
+  VALUE vkey, vhash;
+  TCADB *adb;
+  VALBUF key;
+  char *vbuf;
+  int i, num, vsiz;
+  Check_Type(vkeys, T_ARRAY);
+  GetADB(vself, adb);
+  vhash = rb_hash_new();
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    if((vbuf = tcadbget(adb, key.ptr, key.size, &vsiz)) != NULL){
+      rb_hash_aset(vhash, vkey, rb_str_new(vbuf, vsiz));
+      tcfree(vbuf);
+    }
+  }
+  return vhash;
+}
+
+
+static VALUE adb_get_into(RBSELF, VALUE vkey, VALUE vbuf){
+  TCADB *adb;
+  VALBUF key;
+  char *vptr, *buf;
+  int max, vsiz;
+  if(vbuf == vkey) rb_raise(rb_eArgError, "the buffer must not be the key");
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  if(!(vptr = tcadbget(adb, key.ptr, key.size, &vsiz))) return Qnil;
+  buf = vstrreserve(vbuf, vsiz, &max);
+  memcpy(buf, vptr, vsiz);
+  tcfree(vptr);
+  vstrsetlen(vbuf, vsiz);
+  return vbuf;
+}
+
+
+static VALUE adb_vsiz(RBSELF, VALUE vkey){
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return INT2NUM(tcadbvsiz(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)));
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  return INT2NUM(tcadbvsiz(adb, key.ptr, key.size));
 }
 
 
-static VALUE adb_iterinit(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_iterinit(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbiterinit(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_iternext(VALUE vself, SEL sel){
-  VALUE vadb, vval;
+static VALUE adb_iternext(RBSELF){
+  VALUE vval;
   TCADB *adb;
   char *vbuf;
   int vsiz;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   if(!(vbuf = tcadbiternext(adb, &vsiz))) return Qnil;
   vval = rb_str_new(vbuf, vsiz);
   tcfree(vbuf);
@@ -3530,58 +5956,54 @@ static VALUE adb_iternext(VALUE vself, SEL sel){
 }
 
 
-static VALUE adb_fwmkeys(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vadb, vprefix, vmax, vary;
+static VALUE adb_fwmkeys(RBVARARGS){
+  VALUE vprefix, vmax, vary;
   TCADB *adb;
   TCLIST *keys;
+  VALBUF prefix;
   int max;
   rb_scan_args(argc, argv, "11", &vprefix, &vmax);
-  vprefix = StringValueEx(vprefix);
+  StringValueBuf(vprefix, &prefix);
   max = (vmax == Qnil) ? -1 : NUM2INT(vmax);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  keys = tcadbfwmkeys(adb, RSTRING_PTR(vprefix), RSTRING_LEN(vprefix), max);
+  GetADB(vself, adb);
+  keys = tcadbfwmkeys(adb, prefix.ptr, prefix.size, max);
   vary = listtovary(keys);
   tclistdel(keys);
   return vary;
 }
 
 
-static VALUE adb_addint(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vadb;
+static VALUE adb_addint(RBSELF, VALUE vkey, VALUE vnum){
   TCADB *adb;
+  VALBUF key;
   int num;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  num = tcadbaddint(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2INT(vnum));
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  num = tcadbaddint(adb, key.ptr, key.size, NUM2INT(vnum));
   return num == INT_MIN ? Qnil : INT2NUM(num);
 }
 
 
-static VALUE adb_adddouble(VALUE vself, SEL sel, VALUE vkey, VALUE vnum){
-  VALUE vadb;
+static VALUE adb_adddouble(RBSELF, VALUE vkey, VALUE vnum){
   TCADB *adb;
+  VALBUF key;
   double num;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  num = tcadbadddouble(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), NUM2DBL(vnum));
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  num = tcadbadddouble(adb, key.ptr, key.size, NUM2DBL(vnum));
   return isnan(num) ? Qnil : rb_float_new(num);
 }
 
 
-static VALUE adb_sync(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_sync(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbsync(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vadb, vparams;
+static VALUE adb_optimize(RBVARARGS){
+  VALUE vparams;
   TCADB *adb;
   const char *params;
   rb_scan_args(argc, argv, "01", &vparams);
@@ -3591,89 +6013,72 @@ static VALUE adb_optimize(VALUE vself, SEL sel, int argc, VALUE *argv){
     Check_Type(vparams, T_STRING);
     params = RSTRING_PTR(vparams);
   }
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadboptimize(adb, params) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_vanish(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_vanish(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbvanish(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_copy(VALUE vself, SEL sel, VALUE vpath){
-  VALUE vadb;
+static VALUE adb_copy(RBSELF, VALUE vpath){
   TCADB *adb;
   Check_Type(vpath, T_STRING);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbcopy(adb, RSTRING_PTR(vpath)) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_tranbegin(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_tranbegin(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbtranbegin(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_trancommit(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_trancommit(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbtrancommit(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_tranabort(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_tranabort(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbtranabort(adb) ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_path(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_path(RBSELF){
   TCADB *adb;
   const char *path;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   if(!(path = tcadbpath(adb))) return Qnil;
   return rb_str_new2(path);
 }
 
 
-static VALUE adb_rnum(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_rnum(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return LL2NUM(tcadbrnum(adb));
 }
 
 
-static VALUE adb_size(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_size(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return LL2NUM(tcadbsize(adb));
 }
 
 
-static VALUE adb_misc(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vadb, vname, vargs, vrv;
+static VALUE adb_misc(RBVARARGS){
+  VALUE vname, vargs, vrv;
   TCADB *adb;
   TCLIST *targs, *res;
   rb_scan_args(argc, argv, "11", &vname, &vargs);
@@ -3684,8 +6089,7 @@ static VALUE adb_misc(VALUE vself, SEL sel, int argc, VALUE *argv){
     Check_Type(vargs, T_ARRAY);
     targs = varytolist(vargs);
   }
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   res = tcadbmisc(adb, RSTRING_PTR(vname), targs);
   if(res){
     vrv = listtovary(res);
@@ -3698,16 +6102,16 @@ static VALUE adb_misc(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE adb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
-  VALUE vadb, vkey, vdef, vval;
+static VALUE adb_fetch(RBVARARGS){
+  VALUE vkey, vdef, vval;
   TCADB *adb;
+  VALBUF key;
   char *vbuf;
   int vsiz;
   rb_scan_args(argc, argv, "11", &vkey, &vdef);
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  if((vbuf = tcadbget(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz)) != NULL){
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  if((vbuf = tcadbget(adb, key.ptr, key.size, &vsiz)) != NULL){
     vval = rb_str_new(vbuf, vsiz);
     tcfree(vbuf);
   } else {
@@ -3717,31 +6121,29 @@ static VALUE adb_fetch(VALUE vself, SEL sel, int argc, VALUE *argv){
 }
 
 
-static VALUE adb_check(VALUE vself, SEL sel, VALUE vkey){
-  VALUE vadb;
+static VALUE adb_check(RBSELF, VALUE vkey){
   TCADB *adb;
-  vkey = StringValueEx(vkey);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  return tcadbvsiz(adb, RSTRING_PTR(vkey), RSTRING_LEN(vkey)) >= 0 ? Qtrue : Qfalse;
+  VALBUF key;
+  StringValueBuf(vkey, &key);
+  GetADB(vself, adb);
+  return tcadbvsiz(adb, key.ptr, key.size) >= 0 ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_check_value(VALUE vself, SEL sel, VALUE vval){
-  VALUE vadb;
+static VALUE adb_check_value(RBSELF, VALUE vval){
   TCADB *adb;
+  VALBUF val;
   char *tkbuf, *tvbuf;
   bool hit;
   int tksiz, tvsiz;
-  vval = StringValueEx(vval);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  StringValueBuf(vval, &val);
+  GetADB(vself, adb);
   hit = false;
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
     tvbuf = tcadbget(adb, tkbuf, tksiz, &tvsiz);
-    if(tvbuf && tvsiz == RSTRING_LEN(vval) &&
-       memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvbuf && tvsiz == val.size &&
+       memcmp(tvbuf, val.ptr, val.size) == 0){
       tcfree(tvbuf);
       tcfree(tkbuf);
       hit = true;
@@ -3754,20 +6156,20 @@ static VALUE adb_check_value(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE adb_get_reverse(VALUE vself, SEL sel, VALUE vval){
-  VALUE vadb, vrv;
+static VALUE adb_get_reverse(RBSELF, VALUE vval){
+  VALUE vrv;
   TCADB *adb;
+  VALBUF val;
   char *tkbuf, *tvbuf;
   int tksiz, tvsiz;
-  vval = StringValueEx(vval);
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  StringValueBuf(vval, &val);
+  GetADB(vself, adb);
   vrv = Qnil;
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
     tvbuf = tcadbget(adb, tkbuf, tksiz, &tvsiz);
-    if(tvbuf && tvsiz == RSTRING_LEN(vval) &&
-       memcmp(tvbuf, RSTRING_PTR(vval), RSTRING_LEN(vval)) == 0){
+    if(tvbuf && tvsiz == val.size &&
+       memcmp(tvbuf, val.ptr, val.size) == 0){
       vrv = rb_str_new(tkbuf, tksiz);
       tcfree(tvbuf);
       tcfree(tkbuf);
@@ -3780,114 +6182,499 @@ static VALUE adb_get_reverse(VALUE vself, SEL sel, VALUE vval){
 }
 
 
-static VALUE adb_empty(VALUE vself, SEL sel){
-  VALUE vadb;
+static VALUE adb_empty(RBSELF){
   TCADB *adb;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  GetADB(vself, adb);
   return tcadbrnum(adb) < 1 ? Qtrue : Qfalse;
 }
 
 
-static VALUE adb_each(VALUE vself, SEL sel){
-  VALUE vadb, vrv;
-  TCADB *adb;
+static VALUE adbiterate(TCADB *adb){
+  VALUE vrv, vkey, vval;
   char *tkbuf, *tvbuf;
   int tksiz, tvsiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
   vrv = Qnil;
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
+    vkey = rb_str_new(tkbuf, tksiz);
     tvbuf = tcadbget(adb, tkbuf, tksiz, &tvsiz);
+    tcfree(tkbuf);
     if(tvbuf){
-      vrv = rb_yield_values(2, rb_str_new(tkbuf, tksiz), rb_str_new(tvbuf, tvsiz));
+      vval = rb_str_new(tvbuf, tvsiz);
       tcfree(tvbuf);
+      vrv = rb_yield_values(2, vkey, vval);
     }
-    tcfree(tkbuf);
   }
   return vrv;
 }
 
 
-static VALUE adb_each_key(VALUE vself, SEL sel){
-  VALUE vadb, vrv;
+static VALUE adb_each(RBSELF){
   TCADB *adb;
-  char *tkbuf;
-  int tksiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  vrv = Qnil;
-  tcadbiterinit(adb);
-  while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
-    vrv = rb_yield(rb_str_new(tkbuf, tksiz));
-    tcfree(tkbuf);
+  if(!rb_block_given_p()) return vnewenum(vself, "each", 0, NULL, true);
+  GetADB(vself, adb);
+  return adbiterate(adb);
+}
+
+
+static VALUE adb_parallel_each(RBVARARGS){
+  VALUE vopts;
+  TCADB *adb;
+  PSCAN scan;
+  int tnum;
+  rb_scan_args(argc, argv, "01", &vopts);
+  if(!rb_block_given_p()) return vnewenum(vself, "parallel_each", argc, argv, true);
+  tnum = vthreadsopt(vopts);
+  GetADB(vself, adb);
+  if(tcadbomode(adb) != ADBOHDB) return adbiterate(adb);
+  if(!pscanstart(&scan, tcadbreveal(adb), tnum)){
+    pscanfree((VALUE)&scan);
+    rb_raise(rb_eThreadError, "cannot create a scanning thread");
   }
-  return vrv;
+  return rb_ensure(pscaniterate, (VALUE)&scan, pscanfree, (VALUE)&scan);
 }
 
 
-static VALUE adb_each_value(VALUE vself, SEL sel){
-  VALUE vadb, vrv;
+static VALUE adb_each_batch(RBSELF, VALUE vnum){
+  VALUE vrv, vrecs;
   TCADB *adb;
   char *tkbuf, *tvbuf;
-  int tksiz, tvsiz;
-  if(rb_block_given_p() != Qtrue) rb_raise(rb_eArgError, "no block given");
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
+  int num, tksiz, tvsiz;
+  if(!rb_block_given_p()) return vnewenum(vself, "each_batch", 1, &vnum, false);
+  num = NUM2INT(vnum);
+  if(num < 1) rb_raise(rb_eArgError, "batch size must be positive");
+  GetADB(vself, adb);
   vrv = Qnil;
+  vrecs = batchnew(num);
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
     tvbuf = tcadbget(adb, tkbuf, tksiz, &tvsiz);
     if(tvbuf){
-      vrv = rb_yield(rb_str_new(tvbuf, tvsiz));
+      rb_ary_push(vrecs, rb_assoc_new(rb_str_new(tkbuf, tksiz), rb_str_new(tvbuf, tvsiz)));
       tcfree(tvbuf);
     }
     tcfree(tkbuf);
+    if(RARRAY_LEN(vrecs) >= num){
+      vrv = rb_yield(vrecs);
+      vrecs = batchnew(num);
+    }
   }
+  if(RARRAY_LEN(vrecs) > 0) vrv = rb_yield(vrecs);
   return vrv;
 }
 
 
-static VALUE adb_keys(VALUE vself, SEL sel){
-  VALUE vadb, vary;
+static VALUE adb_each_key(RBSELF){
+  VALUE vrv, vkey;
   TCADB *adb;
   char *tkbuf;
   int tksiz;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  vary = rb_ary_new2(tcadbrnum(adb));
+  if(!rb_block_given_p()) return vnewenum(vself, "each_key", 0, NULL, true);
+  GetADB(vself, adb);
+  vrv = Qnil;
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
-    rb_ary_push(vary, rb_str_new(tkbuf, tksiz));
+    vkey = rb_str_new(tkbuf, tksiz);
     tcfree(tkbuf);
+    vrv = rb_yield(vkey);
   }
-  return vary;
+  return vrv;
 }
 
 
-static VALUE adb_values(VALUE vself, SEL sel){
-  VALUE vadb, vary;
+static VALUE adb_each_value(RBSELF){
+  VALUE vrv, vval;
   TCADB *adb;
   char *tkbuf, *tvbuf;
   int tksiz, tvsiz;
-  vadb = rb_iv_get(vself, ADBVNDATA);
-  Data_Get_Struct(vadb, TCADB, adb);
-  vary = rb_ary_new2(tcadbrnum(adb));
+  if(!rb_block_given_p()) return vnewenum(vself, "each_value", 0, NULL, true);
+  GetADB(vself, adb);
+  vrv = Qnil;
   tcadbiterinit(adb);
   while((tkbuf = tcadbiternext(adb, &tksiz)) != NULL){
     tvbuf = tcadbget(adb, tkbuf, tksiz, &tvsiz);
+    tcfree(tkbuf);
     if(tvbuf){
-      rb_ary_push(vary, rb_str_new(tvbuf, tvsiz));
+      vval = rb_str_new(tvbuf, tvsiz);
       tcfree(tvbuf);
+      vrv = rb_yield(vval);
     }
-    tcfree(tkbuf);
+  }
+  return vrv;
+}
+
+
+static VALUE adb_keys(RBSELF){
+  return vnewenum(vself, "each_key", 0, NULL, true);
+}
+
+
+static VALUE adb_values(RBSELF){
+  return vnewenum(vself, "each_value", 0, NULL, true);
+}
+
+
+static void view_init(void){
+  cls_view = rb_define_class_under(mod_tokyocabinet, "View", rb_cObject);
+  rb_undef_alloc_func(cls_view);
+  rb_objc_define_method(cls_view, "size", view_size, 0);
+  rb_objc_define_method(cls_view, "bytesize", view_size, 0);
+  rb_objc_define_method(cls_view, "to_s", view_to_s, 0);
+  rb_objc_define_method(cls_view, "to_str", view_to_s, 0);
+  rb_objc_define_method(cls_view, "getbyte", view_getbyte, 1);
+  rb_objc_define_method(cls_view, "byteslice", view_byteslice, -1);
+  rb_objc_define_method(cls_view, "[]", view_byteslice, -1);
+  rb_objc_define_method(cls_view, "start_with?", view_start_with, 1);
+  rb_objc_define_method(cls_view, "==", view_equal, 1);
+  rb_objc_define_method(cls_view, "valid?", view_valid, 0);
+  rb_objc_define_method(cls_view, "inspect", view_inspect, 0);
+}
+
+
+static VALUE view_size(RBSELF){
+  VIEWDATA *data;
+  GetVIEW(vself, data);
+  return INT2NUM(data->size);
+}
+
+
+static VALUE view_to_s(RBSELF){
+  VIEWDATA *data;
+  GetVIEW(vself, data);
+  return rb_str_new(data->ptr, data->size);
+}
+
+
+static VALUE view_getbyte(RBSELF, VALUE vidx){
+  VIEWDATA *data;
+  int idx;
+  GetVIEW(vself, data);
+  idx = NUM2INT(vidx);
+  if(idx < 0) idx += data->size;
+  if(idx < 0 || idx >= data->size) return Qnil;
+  return INT2FIX(((unsigned char *)data->ptr)[idx]);
+}
+
+
+static VALUE view_byteslice(RBVARARGS){
+  VALUE vstart, vlen;
+  VIEWDATA *data;
+  int start, len;
+  rb_scan_args(argc, argv, "11", &vstart, &vlen);
+  GetVIEW(vself, data);
+  start = NUM2INT(vstart);
+  len = (vlen == Qnil) ? 1 : NUM2INT(vlen);
+  if(start < 0) start += data->size;
+  if(start < 0 || start > data->size || len < 0) return Qnil;
+  if(len > data->size - start) len = data->size - start;
+  return rb_str_new(data->ptr + start, len);
+}
+
+
+static VALUE view_start_with(RBSELF, VALUE vstr){
+  VIEWDATA *data;
+  GetVIEW(vself, data);
+  vstr = StringValue(vstr);
+  return (RSTRING_LEN(vstr) <= data->size &&
+          !memcmp(data->ptr, RSTRING_PTR(vstr), RSTRING_LEN(vstr))) ? Qtrue : Qfalse;
+}
+
+
+static VALUE view_equal(RBSELF, VALUE vobj){
+  VIEWDATA *data, *odata;
+  GetVIEW(vself, data);
+  if(rb_obj_is_kind_of(vobj, cls_view) == Qtrue){
+    GetVIEW(vobj, odata);
+    return (odata->size == data->size && !memcmp(odata->ptr, data->ptr, data->size)) ? Qtrue : Qfalse;
+  }
+  if(TYPE(vobj) != T_STRING) return Qfalse;
+  return (RSTRING_LEN(vobj) == data->size &&
+          !memcmp(RSTRING_PTR(vobj), data->ptr, data->size)) ? Qtrue : Qfalse;
+}
+
+
+static VALUE view_valid(RBSELF){
+  VIEWDATA *data;
+  GetDATA(vself, VIEWDATA, &view_type, data);
+  return data->ptr ? Qtrue : Qfalse;
+}
+
+
+static VALUE view_inspect(RBSELF){
+  VIEWDATA *data;
+  char buf[NUMBUFSIZ*2];
+  GetDATA(vself, VIEWDATA, &view_type, data);
+  if(!data->ptr) return rb_str_new2("#<TokyoCabinet::View (expired)>");
+  sprintf(buf, "#<TokyoCabinet::View %d bytes>", data->size);
+  return rb_str_new2(buf);
+}
+
+
+
+static VALUE rownew(TCMAP *cols){
+  VALUE vrow;
+  ROWDATA *data;
+  data = tcmalloc(sizeof(*data));
+  vrow = WrapDATA(cls_row, &row_type, data);
+  data->cols = cols;
+  data->dirty = false;
+  return vrow;
+}
+
+
+static bool rowexpire(VALUE vrow){
+  ROWDATA *data;
+  GetDATA(vrow, ROWDATA, &row_type, data);
+  data->cols = NULL;
+  return data->dirty;
+}
+
+
+static VALUE roweach(VALUE vself, const char *name, int mode){
+  VALUE vkeys, vkey, vval, vhash, vrv;
+  ROWDATA *data;
+  const char *vbuf;
+  int i, num, vsiz;
+  if(!rb_block_given_p()) return vnewenum(vself, name, 0, NULL, false);
+  GetROW(vself, data);
+  vkeys = maptovkeys(data->cols);
+  vhash = (mode == IMSELECT || mode == IMREJECT) ? rb_hash_new() : Qnil;
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    GetROW(vself, data);
+    vbuf = tcmapget(data->cols, RSTRING_PTR(vkey), RSTRING_LEN(vkey), &vsiz);
+    if(!vbuf) continue;
+    vval = rb_str_new(vbuf, vsiz);
+    switch(mode){
+    case IMKEY:
+      rb_yield(vkey);
+      break;
+    case IMVALUE:
+      rb_yield(vval);
+      break;
+    case IMSELECT:
+    case IMREJECT:
+      vrv = rb_yield_values(2, vkey, vval);
+      if(RTEST(vrv) == (mode == IMSELECT)) rb_hash_aset(vhash, vkey, vval);
+      break;
+    default:
+      rb_yield_values(2, vkey, vval);
+      break;
+    }
+  }
+  return (vhash != Qnil) ? vhash : vself;
+}
+
+
+static void row_init(void){
+  cls_row = rb_define_class_under(cls_tdbqry, "Row", rb_cObject);
+  rb_undef_alloc_func(cls_row);
+  rb_include_module(cls_row, rb_mEnumerable);
+  rb_objc_define_method(cls_row, "[]", row_get, 1);
+  rb_objc_define_method(cls_row, "fetch", row_fetch, -1);
+  rb_objc_define_method(cls_row, "[]=", row_put, 2);
+  rb_objc_define_method(cls_row, "store", row_put, 2);
+  rb_objc_define_method(cls_row, "delete", row_delete, 1);
+  rb_objc_define_method(cls_row, "merge!", row_merge, 1);
+  rb_objc_define_method(cls_row, "update", row_merge, 1);
+  rb_objc_define_method(cls_row, "clear", row_clear, 0);
+  rb_objc_define_method(cls_row, "has_key?", row_has_key, 1);
+  rb_objc_define_method(cls_row, "key?", row_has_key, 1);
+  rb_objc_define_method(cls_row, "include?", row_has_key, 1);
+  rb_objc_define_method(cls_row, "member?", row_has_key, 1);
+  rb_objc_define_method(cls_row, "keys", row_keys, 0);
+  rb_objc_define_method(cls_row, "values", row_values, 0);
+  rb_objc_define_method(cls_row, "size", row_size, 0);
+  rb_objc_define_method(cls_row, "length", row_size, 0);
+  rb_objc_define_method(cls_row, "empty?", row_empty, 0);
+  rb_objc_define_method(cls_row, "each", row_each, 0);
+  rb_objc_define_method(cls_row, "each_pair", row_each, 0);
+  rb_objc_define_method(cls_row, "each_key", row_each_key, 0);
+  rb_objc_define_method(cls_row, "each_value", row_each_value, 0);
+  rb_objc_define_method(cls_row, "select", row_select, 0);
+  rb_objc_define_method(cls_row, "reject", row_reject, 0);
+  rb_objc_define_method(cls_row, "to_hash", row_to_hash, 0);
+  rb_objc_define_method(cls_row, "to_h", row_to_hash, 0);
+  rb_objc_define_method(cls_row, "dup", row_to_hash, 0);
+  rb_objc_define_method(cls_row, "valid?", row_valid, 0);
+}
+
+
+static VALUE row_get(RBSELF, VALUE vname){
+  ROWDATA *data;
+  VALBUF name;
+  const char *vbuf;
+  int vsiz;
+  GetROW(vself, data);
+  StringValueBuf(vname, &name);
+  vbuf = tcmapget(data->cols, name.ptr, name.size, &vsiz);
+  return vbuf ? rb_str_new(vbuf, vsiz) : Qnil;
+}
+
+
+static VALUE row_fetch(RBVARARGS){
+  VALUE vname, vdef;
+  ROWDATA *data;
+  VALBUF name;
+  const char *vbuf;
+  int vsiz;
+  rb_scan_args(argc, argv, "11", &vname, &vdef);
+  GetROW(vself, data);
+  StringValueBuf(vname, &name);
+  vbuf = tcmapget(data->cols, name.ptr, name.size, &vsiz);
+  if(vbuf) return rb_str_new(vbuf, vsiz);
+  if(rb_block_given_p()) return rb_yield(vname);
+  if(argc > 1) return vdef;
+  rb_raise(rb_eKeyError, "column not found");
+  return Qnil;
+}
+
+
+static VALUE row_put(RBSELF, VALUE vname, VALUE vval){
+  ROWDATA *data;
+  VALBUF name, val;
+  GetROW(vself, data);
+  StringValueBuf(vname, &name);
+  StringValueBuf(vval, &val);
+  tcmapput(data->cols, name.ptr, name.size, val.ptr, val.size);
+  data->dirty = true;
+  return vval;
+}
+
+
+static VALUE row_delete(RBSELF, VALUE vname){
+  VALUE vval;
+  ROWDATA *data;
+  VALBUF name;
+  const char *vbuf;
+  int vsiz;
+  GetROW(vself, data);
+  StringValueBuf(vname, &name);
+  vbuf = tcmapget(data->cols, name.ptr, name.size, &vsiz);
+  if(!vbuf) return Qnil;
+  vval = rb_str_new(vbuf, vsiz);
+  tcmapout(data->cols, name.ptr, name.size);
+  data->dirty = true;
+  return vval;
+}
+
+
+static VALUE row_merge(RBSELF, VALUE vhash){
+  VALUE vkeys, vkey;
+  ROWDATA *data;
+  VALBUF key, val;
+  int i, num;
+  GetROW(vself, data);
+  Check_Type(vhash, T_HASH);
+  vkeys = rb_funcall(vhash, rb_intern("keys"), 0);
+  num = RARRAY_LEN(vkeys);
+  for(i = 0; i < num; i++){
+    vkey = rb_ary_entry(vkeys, i);
+    StringValueBuf(vkey, &key);
+    StringValueBuf(rb_hash_aref(vhash, vkey), &val);
+    GetROW(vself, data);
+    tcmapput(data->cols, key.ptr, key.size, val.ptr, val.size);
+    data->dirty = true;
+  }
+  return vself;
+}
+
+
+static VALUE row_clear(RBSELF){
+  ROWDATA *data;
+  GetROW(vself, data);
+  tcmapclear(data->cols);
+  data->dirty = true;
+  return vself;
+}
+
+
+static VALUE row_has_key(RBSELF, VALUE vname){
+  ROWDATA *data;
+  VALBUF name;
+  int vsiz;
+  GetROW(vself, data);
+  StringValueBuf(vname, &name);
+  return tcmapget(data->cols, name.ptr, name.size, &vsiz) ? Qtrue : Qfalse;
+}
+
+
+static VALUE row_keys(RBSELF){
+  ROWDATA *data;
+  GetROW(vself, data);
+  return maptovkeys(data->cols);
+}
+
+
+static VALUE row_values(RBSELF){
+  VALUE vary;
+  ROWDATA *data;
+  const char *kbuf, *vbuf;
+  int ksiz, vsiz;
+  GetROW(vself, data);
+  vary = rb_ary_new2(tcmaprnum(data->cols));
+  tcmapiterinit(data->cols);
+  while((kbuf = tcmapiternext(data->cols, &ksiz)) != NULL){
+    vbuf = tcmapiterval(kbuf, &vsiz);
+    rb_ary_push(vary, rb_str_new(vbuf, vsiz));
   }
   return vary;
 }
 
 
+static VALUE row_size(RBSELF){
+  ROWDATA *data;
+  GetROW(vself, data);
+  return INT2NUM(tcmaprnum(data->cols));
+}
+
+
+static VALUE row_empty(RBSELF){
+  ROWDATA *data;
+  GetROW(vself, data);
+  return tcmaprnum(data->cols) < 1 ? Qtrue : Qfalse;
+}
+
+
+static VALUE row_each(RBSELF){
+  return roweach(vself, "each", IMPAIR);
+}
+
+
+static VALUE row_each_key(RBSELF){
+  return roweach(vself, "each_key", IMKEY);
+}
+
+
+static VALUE row_each_value(RBSELF){
+  return roweach(vself, "each_value", IMVALUE);
+}
+
+
+static VALUE row_select(RBSELF){
+  return roweach(vself, "select", IMSELECT);
+}
+
+
+static VALUE row_reject(RBSELF){
+  return roweach(vself, "reject", IMREJECT);
+}
+
+
+static VALUE row_to_hash(RBSELF){
+  ROWDATA *data;
+  GetROW(vself, data);
+  return maptovhash(data->cols);
+}
+
+
+static VALUE row_valid(RBSELF){
+  ROWDATA *data;
+  GetDATA(vself, ROWDATA, &row_type, data);
+  return data->cols ? Qtrue : Qfalse;
+}
+
+
 
 /* END OF FILE */